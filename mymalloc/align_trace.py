@@ -0,0 +1,42 @@
+#!/usr/bin/env python
+#
+# align_trace.py - rewrite a trace with aligned allocation requests.
+#
+# Every malloc of at least MIN_SIZE bytes becomes an aligned_alloc, like
+# the buffers of SIMD code:
+#   m {pointer-id} {alignment} {size}   aligned_alloc
+# Running mdriver on the original and the rewritten traces shows what the
+# alignment costs in utilization and throughput.
+#
+# Usage: ./align_trace.py traces/trace_c4_v0 [alignment] > aligned_traces/trace_c4_v0
+#
+from __future__ import print_function
+import sys
+
+MIN_SIZE = 64
+ALIGNMENT = 64
+
+
+def main():
+    if len(sys.argv) not in (2, 3):
+        sys.exit('usage: %s <tracefile> [alignment]' % sys.argv[0])
+    alignment = int(sys.argv[2]) if len(sys.argv) == 3 else ALIGNMENT
+    if alignment <= 0 or alignment & (alignment - 1):
+        sys.exit('alignment must be a power of two: %d' % alignment)
+    with open(sys.argv[1]) as f:
+        tokens = f.read().split()
+    out = tokens[:4]
+    i = 4
+    while i < len(tokens):
+        kind = tokens[i]
+        width = {'f': 2, 'F': 3, 'A': 4, 'm': 4}.get(kind, 3)
+        if kind == 'a' and int(tokens[i + 2]) >= MIN_SIZE:
+            out.append('m %s %d %s' % (tokens[i + 1], alignment, tokens[i + 2]))
+        else:
+            out.append(' '.join(tokens[i:i + width]))
+        i += width
+    print('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
@@ -20,6 +20,7 @@
  * IN THE SOFTWARE.
  **/
 
+#include <math.h>
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
@@ -47,6 +48,189 @@
 
 binned_free_list bfl;
 
+#ifdef BFL_ADAPTIVE
+// Workload fingerprinting. The first FP_WINDOW malloc and realloc requests
+// are counted by size class and by kind. Then the nearest profile below
+// (L1 distance over those fractions) replaces the parameters for the rest
+// of the run, unless none is within FP_MAX_DISTANCE: an unknown workload
+// keeps the parameters bfl_params_load gave it.
+#define FP_WINDOW 1024
+#define FP_CLASSES 4          // sizes <= 64, <= 512, <= 4096, larger
+#define FP_MAX_DISTANCE 0.3
+
+typedef struct {
+  const char* name;
+  double size_mix[FP_CLASSES];  // fraction of requests in each size class
+  double realloc_ratio;         // fraction of requests that are reallocs
+  bfl_params_t params;
+} workload_profile;
+
+// The profiles: the fingerprint of each trace of additional_traces/ and
+// the min block and min split sizes that did best on it, generated by
+// make_profiles.py (make profiles). They are tuned on other variants than
+// the ones in traces/, so they are not fitted to the traces they are
+// scored on. BFL_GROW_MAX, BFL_VICTIM_MAX, BFL_HOT_SLOTS, BFL_FIT_ADAPTIVE
+// and BFL_ALIGN_SCAN are deliberately left out: they size structures or
+// compile code in or out, so they can't change once the run has started.
+#include "./profiles.h"
+
+static struct {
+  int requests;              // counted so far, up to FP_WINDOW
+  int sizes[FP_CLASSES];
+  int reallocs;
+  const workload_profile* profile;  // the match, or NULL
+} fingerprint;
+
+static void fingerprint_match() {
+  double best = FP_MAX_DISTANCE;
+  for (size_t i = 0; i < sizeof(profiles) / sizeof(profiles[0]); i++) {
+    double d = fabs((double) fingerprint.reallocs / FP_WINDOW -
+                    profiles[i].realloc_ratio);
+    for (int k = 0; k < FP_CLASSES; k++) {
+      d += fabs((double) fingerprint.sizes[k] / FP_WINDOW -
+                profiles[i].size_mix[k]);
+    }
+    if (d <= best) {
+      best = d;
+      fingerprint.profile = &profiles[i];
+    }
+  }
+  if (fingerprint.profile != NULL) {
+    bfl_params_use(&fingerprint.profile->params);
+  }
+}
+
+static inline void fingerprint_note(size_t size, bool is_realloc) {
+  if (fingerprint.requests >= FP_WINDOW) return;
+  fingerprint.sizes[(size <= 64) ? 0 : (size <= 512) ? 1 :
+                    (size <= 4096) ? 2 : 3]++;
+  fingerprint.reallocs += is_realloc;
+  if (++fingerprint.requests == FP_WINDOW) fingerprint_match();
+}
+#endif
+
+#ifdef BFL_LIFETIME
+// Lifetime segregation. Blocks that outlive the churn around them pin
+// down the free space between them, so mallocs predicted to be long-lived
+// get their blocks from bfl_long, which grows a memlib region of its own,
+// and the short-lived churn in bfl coalesces without them.
+//
+// Lifetimes are measured in mallocs. One malloc in LT_SAMPLE is sampled
+// into a table indexed by address; its free gives its lifetime. Every
+// LT_LONG mallocs the table is swept, and a sample older than LT_LONG is
+// counted long-lived there, so that blocks that are never freed count
+// too; so is a sample pushed out of the table by another. Each size class
+// (four per power of two) counts the lifetimes under and over LT_LONG,
+// halved past LT_MAX_SAMPLES, and predicts long-lived once it has
+// LT_MIN_SAMPLES and LT_LONG_SHARE of them are long.
+#define LT_REGION 1
+#define LT_CLASSES (4 * BFL_SIZE)
+#define LT_SAMPLE 8
+#define LT_TABLE 1024
+#define LT_LONG 1024
+#define LT_MIN_SAMPLES 8
+#define LT_MAX_SAMPLES 64
+#define LT_LONG_SHARE 0.75
+
+binned_free_list bfl_long;
+
+static struct {
+  uint32_t mallocs;
+  char* long_lo;   // where bfl_long's region starts
+  size_t routed;   // mallocs given to bfl_long
+  struct {
+    void* ptr;
+    uint32_t birth;  // mallocs when it was allocated
+    uint16_t cls;
+    bool counted;    // already counted long-lived by a sweep
+  } samples[LT_TABLE];
+  struct {
+    uint16_t shorts;
+    uint16_t longs;
+    bool is_long;
+  } classes[LT_CLASSES];
+} lifetime;
+
+static inline uint32_t lt_class(size_t size) {
+  if (size < 4) return size;
+  lgsize_t k = lg2_down(size);
+  if (k >= BFL_SIZE) return LT_CLASSES - 1;
+  return (k << 2) | ((size >> (k - 2)) & 3);
+}
+
+static inline uint32_t lt_slot(void* ptr) {
+  return (uint32_t) (((uintptr_t) ptr >> 3) * 2654435761u) % LT_TABLE;
+}
+
+static void lt_observe(uint32_t cls, uint32_t age) {
+  if (age >= LT_LONG) {
+    lifetime.classes[cls].longs++;
+  } else {
+    lifetime.classes[cls].shorts++;
+  }
+  const uint32_t n = lifetime.classes[cls].longs + lifetime.classes[cls].shorts;
+  if (n > LT_MAX_SAMPLES) {
+    lifetime.classes[cls].longs /= 2;
+    lifetime.classes[cls].shorts /= 2;
+  }
+  lifetime.classes[cls].is_long = n >= LT_MIN_SAMPLES &&
+      lifetime.classes[cls].longs >= LT_LONG_SHARE * n;
+}
+
+// Count the samples that have lived long enough, once each
+static void lt_sweep() {
+  for (int i = 0; i < LT_TABLE; i++) {
+    if (lifetime.samples[i].ptr != NULL && !lifetime.samples[i].counted &&
+        lifetime.mallocs - lifetime.samples[i].birth >= LT_LONG) {
+      lifetime.samples[i].counted = true;
+      lt_observe(lifetime.samples[i].cls, LT_LONG);
+    }
+  }
+}
+
+static void lt_sample(void* ptr, uint32_t cls) {
+  const uint32_t i = lt_slot(ptr);
+  if (lifetime.samples[i].ptr != NULL && !lifetime.samples[i].counted) {
+    const uint32_t age = lifetime.mallocs - lifetime.samples[i].birth;
+    if (age >= LT_LONG) lt_observe(lifetime.samples[i].cls, age);
+  }
+  lifetime.samples[i].ptr = ptr;
+  lifetime.samples[i].birth = lifetime.mallocs;
+  lifetime.samples[i].cls = cls;
+  lifetime.samples[i].counted = false;
+}
+
+// Note that ptr goes away; if it was sampled, its lifetime is known
+static inline void lt_forget(void* ptr, bool observe) {
+  const uint32_t i = lt_slot(ptr);
+  if (lifetime.samples[i].ptr != ptr) return;
+  lifetime.samples[i].ptr = NULL;
+  if (observe && !lifetime.samples[i].counted) {
+    lt_observe(lifetime.samples[i].cls,
+               lifetime.mallocs - lifetime.samples[i].birth);
+  }
+}
+
+static inline binned_free_list* lt_owner(void* ptr) {
+  return ((char*) ptr >= lifetime.long_lo) ? &bfl_long : &bfl;
+}
+
+static void* lt_malloc(size_t size) {
+  const uint32_t cls = lt_class(size);
+  void* ptr = NULL;
+  lifetime.mallocs++;
+  if (lifetime.classes[cls].is_long) {
+    // Falls back to bfl when the region is full
+    ptr = bfl_malloc(&bfl_long, size);
+    lifetime.routed += (ptr != NULL);
+  }
+  if (ptr == NULL) ptr = bfl_malloc(&bfl, size);
+  if (lifetime.mallocs % LT_SAMPLE == 0 && ptr != NULL) lt_sample(ptr, cls);
+  if (lifetime.mallocs % LT_LONG == 0) lt_sweep();
+  return ptr;
+}
+#endif
+
 // Not used, only return 0
 int my_check() {
   return 0;
@@ -56,24 +240,195 @@ int my_check() {
 // calls are made.  Since this is a very simple implementation, we just
 // return success.
 int my_init() {
-  bfl = bfl_new();
+  bfl_params_load();
+#ifdef BFL_ADAPTIVE
+  memset(&fingerprint, 0, sizeof(fingerprint));
+#endif
+  bfl = bfl_new(0);
+#ifdef BFL_LIFETIME
+  bfl_long = bfl_new(LT_REGION);
+  memset(&lifetime, 0, sizeof(lifetime));
+  lifetime.long_lo = mem_region_lo(LT_REGION);
+#endif
   return 0;
 }
 
 //  malloc - Allocate a block by incrementing the brk pointer.
 //  Always allocate a block whose size is a multiple of the alignment.
 void * my_malloc(size_t size) {
+#ifdef BFL_ADAPTIVE
+  fingerprint_note(size, false);
+#endif
+#ifdef BFL_LIFETIME
+  return lt_malloc(size);
+#else
   return bfl_malloc(&bfl, size);
+#endif
+}
+
+// aligned_alloc - Allocate a block whose payload is aligned to alignment,
+// a power of two. Aligned blocks always come from the main region.
+void * my_aligned_alloc(size_t alignment, size_t size) {
+  if ((alignment & (alignment - 1)) != 0) return NULL;
+#ifdef BFL_ADAPTIVE
+  fingerprint_note(size, false);
+#endif
+  return bfl_memalign(&bfl, alignment, size);
+}
+
+// calloc - Allocate nmemb * size zeroed bytes, from the main region like
+// aligned blocks. Only what is not fresh from mem_sbrk gets zeroed.
+void * my_calloc(size_t nmemb, size_t size) {
+  if (size != 0 && nmemb > SIZE_MAX / size) return NULL;
+#ifdef BFL_ADAPTIVE
+  fingerprint_note(nmemb * size, false);
+#endif
+  return bfl_calloc(&bfl, nmemb * size);
 }
 
 // free - Freeing a block does nothing.
 void my_free(void *ptr) {
+#ifdef BFL_LIFETIME
+  if (ptr == NULL) return;
+  lt_forget(ptr, true);
+  bfl_free(lt_owner(ptr), ptr);
+#else
   bfl_free(&bfl, ptr);
+#endif
+}
+
+// free_sized - Free a block malloc'd or realloc'd to size bytes.
+void my_free_sized(void *ptr, size_t size) {
+#ifdef BFL_LIFETIME
+  if (ptr == NULL) return;
+  lt_forget(ptr, true);
+  bfl_free_sized(lt_owner(ptr), ptr, size);
+#else
+  bfl_free_sized(&bfl, ptr, size);
+#endif
 }
 
 // realloc - Implemented simply in terms of malloc and free
 void * my_realloc(void *ptr, size_t size) {
+#ifdef BFL_ADAPTIVE
+  fingerprint_note(size, true);
+#endif
+#ifdef BFL_LIFETIME
+  // A moved block is a new one, whose lifetime says nothing about the class
+  if (ptr == NULL) return lt_malloc(size);
+  lt_forget(ptr, false);
+  return bfl_realloc(lt_owner(ptr), ptr, size);
+#else
   return bfl_realloc(&bfl, ptr, size);
+#endif
+}
+
+// Add the counters and the free blocks of one binned free list to stats
+static void stats_add(malloc_stats_t* stats, const binned_free_list* b) {
+#ifdef BFL_STATS
+  stats->has_counters = 1;
+  stats->mallocs += b->stats.mallocs;
+  stats->nodes_visited += b->stats.nodes_visited;
+  stats->splits += b->stats.splits;
+  stats->coalesces += b->stats.coalesces;
+  stats->sbrk_calls += b->stats.sbrk_calls;
+  stats->sbrk_bytes += b->stats.sbrk_bytes;
+  stats->realloc_in_place += b->stats.realloc_in_place;
+  stats->realloc_copies += b->stats.realloc_copies;
+  stats->realloc_bytes_copied += b->stats.realloc_bytes_copied;
+  stats->hot_hits += b->stats.hot_hits;
+  stats->victim_hits += b->stats.victim_hits;
+  stats->calloc_bytes += b->stats.calloc_bytes;
+  stats->calloc_zeroed += b->stats.calloc_zeroed;
+#endif
+  for (int k = 0; k < BFL_SIZE; k++) {
+    size_t blocks = 0;
+    size_t bytes = 0;
+    for (Node* node = b->lists[k]; node != NULL; node = node->next) {
+      blocks++;
+      bytes += GET_SIZE(node);
+      if (GET_SIZE(node) > stats->largest_free) {
+        stats->largest_free = GET_SIZE(node);
+      }
+    }
+#ifdef BFL_SIDE_INDEX
+    for (int32_t i = 0; i < b->side[k].n; i++) {
+      blocks++;
+      bytes += b->side[k].sizes[i];
+      if ((size_t) b->side[k].sizes[i] > stats->largest_free) {
+        stats->largest_free = b->side[k].sizes[i];
+      }
+    }
+#endif
+    stats->bin_blocks[k] += blocks;
+    stats->bin_bytes[k] += bytes;
+    stats->free_blocks += blocks;
+    stats->free_bytes += bytes;
+  }
+  if (b->victim != NULL) {
+    stats->free_blocks++;
+    stats->free_bytes += GET_SIZE(b->victim);
+    if (GET_SIZE(b->victim) > stats->largest_free) {
+      stats->largest_free = GET_SIZE(b->victim);
+    }
+  }
+#if BFL_HOT_SLOTS > 0
+  // Blocks in the hot-size caches are free too, though in no bin
+  for (int i = 0; i < BFL_HOT_SLOTS; i++) {
+    stats->free_blocks += b->hot[i].cached;
+    stats->free_bytes += b->hot[i].cached * b->hot[i].size;
+  }
+#endif
+}
+
+// malloc_batch - n blocks of size bytes, contiguous in groups
+size_t my_malloc_batch(size_t size, size_t n, void **out) {
+#ifdef BFL_ADAPTIVE
+  for (size_t i = 0; i < n && fingerprint.requests < FP_WINDOW; i++) {
+    fingerprint_note(size, false);
+  }
+#endif
+#ifdef BFL_LIFETIME
+  // Each block is predicted and sampled on its own
+  size_t i;
+  for (i = 0; i < n && (out[i] = lt_malloc(size)) != NULL; i++) {}
+  return i;
+#else
+  return bfl_malloc_batch(&bfl, size, n, out);
+#endif
+}
+
+// free_batch - Free n blocks, merging the adjacent ones first
+void my_free_batch(void **ptrs, size_t n) {
+#ifdef BFL_LIFETIME
+  for (size_t i = 0; i < n; i++) {
+    my_free(ptrs[i]);
+  }
+#else
+  bfl_free_batch(&bfl, ptrs, n);
+#endif
+}
+
+// stats - The current free blocks of each bin, plus the counters of the
+// binned free list since my_init when built with -DBFL_STATS, so that the
+// counters cost nothing otherwise.
+const malloc_stats_t * my_stats() {
+  static malloc_stats_t stats;
+  memset(&stats, 0, sizeof(stats));
+  stats.num_bins = BFL_SIZE;
+  stats_add(&stats, &bfl);
+  for (int k = 0; k < BFL_SIZE; k++) {
+    stats.bin_policy[k] = "bfn"[bfl.bins[k].policy];
+  }
+#ifdef BFL_LIFETIME
+  stats_add(&stats, &bfl_long);
+  stats.long_lived = lifetime.routed;
+  stats.long_lived_heap = mem_region_size(LT_REGION);
+#endif
+#ifdef BFL_ADAPTIVE
+  if (fingerprint.profile != NULL) stats.profile = fingerprint.profile->name;
+#endif
+  return &stats;
 }
 
 // call mem_reset_brk.
@@ -26,6 +26,48 @@
 #ifndef _ALLOCATOR_INTERFACE_H
 #define _ALLOCATOR_INTERFACE_H
 
+/* Statistics about an allocator's heap.  The free-block summary describes
+ * the heap right now and is always filled in.  The counters describe what
+ * the allocator did since its last init, and are only maintained when
+ * has_counters is set (for bfl, when built with -DBFL_STATS).
+ * Implementations that can't look inside their heap return NULL.
+ */
+#define MALLOC_STATS_BINS 64
+
+typedef struct {
+  size_t free_blocks;       // free blocks in the heap
+  size_t free_bytes;        // bytes in free blocks, headers included
+  size_t largest_free;      // size of the largest free block
+
+  int has_counters;         // are the counters below maintained?
+  size_t mallocs;           // calls to malloc
+  size_t nodes_visited;     // free-list nodes examined by malloc
+  size_t splits;            // free blocks split in two
+  size_t coalesces;         // free blocks merged with a neighbour
+  size_t sbrk_calls;        // calls to mem_sbrk
+  size_t sbrk_bytes;        // bytes requested from mem_sbrk
+  size_t realloc_in_place;  // reallocs that kept their block
+  size_t realloc_copies;    // reallocs that moved to a new block
+  size_t realloc_bytes_copied;  // bytes memcpy'd by moving reallocs
+  size_t hot_hits;          // mallocs served from a hot-size cache
+  size_t victim_hits;       // mallocs carved from the last split's remainder
+  size_t calloc_bytes;      // bytes requested by calloc
+  size_t calloc_zeroed;     // of those, bytes calloc had to zero
+  int num_bins;             // entries used in bin_blocks/bin_bytes
+  size_t bin_blocks[MALLOC_STATS_BINS];  // free blocks per bin right now
+  size_t bin_bytes[MALLOC_STATS_BINS];   // free bytes per bin right now
+  char bin_policy[MALLOC_STATS_BINS];    // fit policy per bin: 'b'est,
+                                         // 'f'irst or 'n'ext, 0 if fixed
+  const char *profile;      // workload profile picked at runtime, or NULL
+  size_t long_lived;        // mallocs predicted long-lived, in their own region
+  size_t long_lived_heap;   // bytes of that region
+} malloc_stats_t;
+
+/* An arena (arena.c): blocks bump-allocated from chunks of the heap and
+ * released all at once by arena_reset or arena_destroy.
+ */
+typedef struct arena arena_t;
+
 /* Function pointers for a malloc implementation.  This is used to allow a
  * single validator to operate on both libc malloc, a buggy malloc, and the
  * student "mm" malloc.
@@ -34,53 +76,107 @@ typedef struct {
   int (*init)(void);
   void *(*malloc)(size_t size);
   void *(*realloc)(void *ptr, size_t size);
+  /* size bytes aligned to alignment, a power of two, or NULL */
+  void *(*aligned_alloc)(size_t alignment, size_t size);
+  /* nmemb * size zeroed bytes, or NULL */
+  void *(*calloc)(size_t nmemb, size_t size);
   void (*free)(void *ptr);
+  /* free of a block malloc'd or realloc'd to size bytes (C23 free_sized) */
+  void (*free_sized)(void *ptr, size_t size);
   int (*check)();
   void (*reset_brk)(void);
   void *(*heap_lo)(void);
   void *(*heap_hi)(void);
+  const malloc_stats_t *(*stats)(void);
+  /* n blocks of size bytes into out[]; returns how many it allocated */
+  size_t (*malloc_batch)(size_t size, size_t n, void **out);
+  /* free the n blocks of ptrs[], which it may reorder */
+  void (*free_batch)(void **ptrs, size_t n);
+  /* Arenas, or NULL if the package has none */
+  arena_t *(*arena_create)(void);
+  void *(*arena_alloc)(arena_t *arena, size_t size);
+  void (*arena_reset)(arena_t *arena);
+  void (*arena_destroy)(arena_t *arena);
 } malloc_impl_t;
 
+/* Name of the malloc_impl_t that an allocator built as a shared object
+ * (make engine) exports, so that mdriver -a can dlopen it.
+ */
+#define ENGINE_SYMBOL "mdriver_engine"
+
 int libc_init();
 void * libc_malloc(size_t size);
 void * libc_realloc(void *ptr, size_t size);
+void * libc_aligned_alloc(size_t alignment, size_t size);
+void * libc_calloc(size_t nmemb, size_t size);
 void libc_free(void *ptr);
+void libc_free_sized(void *ptr, size_t size);
 int libc_check();
 void libc_reset_brk();
 void * libc_heap_lo();
 void * libc_heap_hi();
+const malloc_stats_t * libc_stats();
+size_t libc_malloc_batch(size_t size, size_t n, void **out);
+void libc_free_batch(void **ptrs, size_t n);
 
 static const malloc_impl_t libc_impl =
 { .init = &libc_init, .malloc = &libc_malloc, .realloc = &libc_realloc,
-  .free = &libc_free, .check = &libc_check, .reset_brk = &libc_reset_brk,
-  .heap_lo = &libc_heap_lo, .heap_hi = &libc_heap_hi};
+  .aligned_alloc = &libc_aligned_alloc, .calloc = &libc_calloc, .free = &libc_free,
+  .free_sized = &libc_free_sized, .check = &libc_check,
+  .reset_brk = &libc_reset_brk, .heap_lo = &libc_heap_lo, .heap_hi = &libc_heap_hi,
+  .stats = &libc_stats, .malloc_batch = &libc_malloc_batch,
+  .free_batch = &libc_free_batch};
 
 int my_init();
 void * my_malloc(size_t size);
 void * my_realloc(void *ptr, size_t size);
+void * my_aligned_alloc(size_t alignment, size_t size);
+void * my_calloc(size_t nmemb, size_t size);
 void my_free(void *ptr);
+void my_free_sized(void *ptr, size_t size);
 int my_check();
 void my_reset_brk();
 void * my_heap_lo();
 void * my_heap_hi();
+const malloc_stats_t * my_stats();
+size_t my_malloc_batch(size_t size, size_t n, void **out);
+void my_free_batch(void **ptrs, size_t n);
+arena_t * my_arena_create(void);
+void * my_arena_alloc(arena_t *arena, size_t size);
+void my_arena_reset(arena_t *arena);
+void my_arena_destroy(arena_t *arena);
 
 static const malloc_impl_t my_impl =
 { .init = &my_init, .malloc = &my_malloc, .realloc = &my_realloc,
-  .free = &my_free, .check = &my_check, .reset_brk = &my_reset_brk,
-  .heap_lo = &my_heap_lo, .heap_hi = &my_heap_hi};
+  .aligned_alloc = &my_aligned_alloc, .calloc = &my_calloc, .free = &my_free,
+  .free_sized = &my_free_sized, .check = &my_check, .reset_brk = &my_reset_brk,
+  .heap_lo = &my_heap_lo, .heap_hi = &my_heap_hi,
+  .stats = &my_stats, .malloc_batch = &my_malloc_batch,
+  .free_batch = &my_free_batch, .arena_create = &my_arena_create,
+  .arena_alloc = &my_arena_alloc, .arena_reset = &my_arena_reset,
+  .arena_destroy = &my_arena_destroy};
 
 int bad_init();
 void * bad_malloc(size_t size);
 void * bad_realloc(void *ptr, size_t size);
+void * bad_aligned_alloc(size_t alignment, size_t size);
+void * bad_calloc(size_t nmemb, size_t size);
 void bad_free(void *ptr);
+void bad_free_sized(void *ptr, size_t size);
 int bad_check();
 void bad_reset_brk();
 void * bad_heap_lo();
 void * bad_heap_hi();
+const malloc_stats_t * bad_stats();
+size_t bad_malloc_batch(size_t size, size_t n, void **out);
+void bad_free_batch(void **ptrs, size_t n);
 
 static const malloc_impl_t bad_impl =
 { .init = &bad_init, .malloc = &bad_malloc, .realloc = &bad_realloc,
-  .free = &bad_free, .check = &bad_check, .reset_brk = &bad_reset_brk,
-  .heap_lo = &bad_heap_lo, .heap_hi = &bad_heap_hi};
+  .aligned_alloc = &bad_aligned_alloc, .calloc = &bad_calloc, .free = &bad_free,
+  .free_sized = &bad_free_sized, .check = &bad_check, .reset_brk = &bad_reset_brk,
+  .heap_lo = &bad_heap_lo, .heap_hi = &bad_heap_hi,
+  .stats = &bad_stats, .malloc_batch = &bad_malloc_batch,
+  .free_batch = &bad_free_batch};
 
 #endif  // _ALLOCATOR_INTERFACE_H
@@ -0,0 +1,111 @@
+/*
+ * arena.c - region allocation on top of the malloc package.
+ *
+ * An arena hands out blocks by bumping a pointer through chunks it gets
+ * from my_malloc, and releases all of them at once: my_arena_reset frees
+ * the chunks, not the blocks, so a request handler that allocates
+ * hundreds of objects and drops them together pays for a few mallocs and
+ * frees instead of one of each per object. Blocks can't be freed or
+ * realloc'd one by one. Arenas live in the heap, so my_init (which
+ * resets it) invalidates them.
+ */
+#include <stdint.h>
+#include <string.h>
+#include "./allocator_interface.h"
+
+// All blocks are aligned like my_malloc's
+#define ARENA_ALIGN(size) (((size) + 7) & ~(size_t) 7)
+
+// The first chunk; each new one is twice the last, up to ARENA_CHUNK_MAX
+#define ARENA_CHUNK_MIN 4096
+#define ARENA_CHUNK_MAX (64 << 10)
+
+// A request over 1/ARENA_BIG_SHARE of the chunk gets a chunk of its own,
+// so that it doesn't waste the rest of the current one
+#define ARENA_BIG_SHARE 4
+
+typedef struct arena_chunk {
+  struct arena_chunk *next;  // older chunks
+  size_t size;               // usable bytes after this header
+} arena_chunk;
+
+struct arena {
+  arena_chunk *chunks;  // the current chunk first, or NULL
+  char *bump;           // next free byte of the current chunk
+  char *end;            // end of the current chunk
+  size_t chunk_size;    // usable bytes of the next chunk
+};
+
+#define CHUNK_START(c) ((char *) ((c) + 1))
+
+arena_t *my_arena_create(void) {
+  arena_t *arena = (arena_t *) my_malloc(sizeof(arena_t));
+  if (arena == NULL) return NULL;
+  memset(arena, 0, sizeof(*arena));
+  arena->chunk_size = ARENA_CHUNK_MIN;
+  return arena;
+}
+
+// Get a chunk of size usable bytes from the malloc package
+static arena_chunk *arena_chunk_new(size_t size) {
+  arena_chunk *chunk = (arena_chunk *) my_malloc(sizeof(arena_chunk) + size);
+  if (chunk != NULL) chunk->size = size;
+  return chunk;
+}
+
+// Slow path of my_arena_alloc: the current chunk is full
+static void *arena_alloc_chunk(arena_t *arena, size_t size) {
+  if (size > arena->chunk_size / ARENA_BIG_SHARE) {
+    // Behind the current chunk, which keeps serving small requests
+    arena_chunk *big = arena_chunk_new(size);
+    if (big == NULL) return NULL;
+    if (arena->chunks != NULL) {
+      big->next = arena->chunks->next;
+      arena->chunks->next = big;
+    } else {
+      big->next = NULL;
+      arena->chunks = big;
+      arena->bump = arena->end = CHUNK_START(big) + size;
+    }
+    return CHUNK_START(big);
+  }
+
+  arena_chunk *chunk = arena_chunk_new(arena->chunk_size);
+  if (chunk == NULL) return NULL;
+  chunk->next = arena->chunks;
+  arena->chunks = chunk;
+  arena->bump = CHUNK_START(chunk) + size;
+  arena->end = CHUNK_START(chunk) + chunk->size;
+  if (arena->chunk_size < ARENA_CHUNK_MAX) arena->chunk_size *= 2;
+  return CHUNK_START(chunk);
+}
+
+void *my_arena_alloc(arena_t *arena, size_t size) {
+  size = ARENA_ALIGN(size);
+  if ((size_t) (arena->end - arena->bump) >= size) {
+    void *p = arena->bump;
+    arena->bump += size;
+    return p;
+  }
+  return arena_alloc_chunk(arena, size);
+}
+
+// Free every chunk but the current one, which is emptied for reuse
+void my_arena_reset(arena_t *arena) {
+  arena_chunk *chunk = arena->chunks;
+  if (chunk == NULL) return;
+  for (arena_chunk *old = chunk->next; old != NULL;) {
+    arena_chunk *next = old->next;
+    my_free(old);
+    old = next;
+  }
+  chunk->next = NULL;
+  arena->bump = CHUNK_START(chunk);
+  arena->end = CHUNK_START(chunk) + chunk->size;
+}
+
+void my_arena_destroy(arena_t *arena) {
+  my_arena_reset(arena);
+  my_free(arena->chunks);
+  my_free(arena);
+}
@@ -41,6 +41,11 @@ int bad_check() {
   return 1;
 }
 
+// bad_stats - No statistics.
+const malloc_stats_t * bad_stats() {
+  return NULL;
+}
+
 // bad_malloc - Allocate a block by incrementing the brk pointer.
 // Always allocate a block whose size is not a multiple of the alignment,
 // and may not fit the requested allocation size.
@@ -61,6 +66,11 @@ void bad_free(void *ptr) {
   // Do nothing.
 }
 
+// bad_free_sized - Freeing a block does nothing, whatever its size.
+void bad_free_sized(void *ptr, size_t size) {
+  bad_free(ptr);
+}
+
 // bad_realloc - Implemented simply in terms of bad_malloc and bad_free, but lacks
 // copy step.
 void * bad_realloc(void *ptr, size_t size) {
@@ -80,6 +90,32 @@ void * bad_realloc(void *ptr, size_t size) {
   return newptr;
 }
 
+// bad_aligned_alloc - Ignores the alignment like bad_malloc ignores the size.
+void * bad_aligned_alloc(size_t alignment, size_t size) {
+  return bad_malloc(size);
+}
+
+// bad_calloc - Takes the memory from mem_sbrk to be zero, which it is not
+// once the heap has been reset.
+void * bad_calloc(size_t nmemb, size_t size) {
+  return bad_malloc(nmemb * size);
+}
+
+// bad_malloc_batch - One bad_malloc per block.
+size_t bad_malloc_batch(size_t size, size_t n, void **out) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if ((out[i] = bad_malloc(size)) == NULL) {
+      break;
+    }
+  }
+  return i;
+}
+
+// bad_free_batch - Freeing blocks does nothing.
+void bad_free_batch(void **ptrs, size_t n) {
+  // Do nothing.
+}
 
 // call mem_reset_brk.
 void bad_reset_brk() {
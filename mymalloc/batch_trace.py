@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+#
+# batch_trace.py - rewrite a trace with batch requests.
+#
+# A run of at least MIN_RUN consecutive mallocs of one size, with
+# consecutive ids, becomes one malloc_batch request, and a run of
+# consecutive frees of consecutive ids one free_batch:
+#   A {first-id} {count} {size}   malloc_batch
+#   F {first-id} {count}          free_batch
+# Running mdriver on the original and the rewritten traces shows what the
+# batch entry points save over a malloc or free per block.
+#
+# Usage: ./batch_trace.py traces/trace_c4_v0 > batched_traces/trace_c4_v0
+#
+from __future__ import print_function
+import sys
+
+MIN_RUN = 2
+
+
+def read_ops(path):
+    with open(path) as f:
+        tokens = f.read().split()
+    ops = []
+    i = 4
+    while i < len(tokens):
+        kind = tokens[i]
+        if kind in ('a', 'c', 'r', 'w'):
+            ops.append((kind, int(tokens[i + 1]), int(tokens[i + 2])))
+            i += 3
+        elif kind == 'f':
+            ops.append((kind, int(tokens[i + 1]), 0))
+            i += 2
+        elif kind == 'm':
+            # Copied as is: alignment and size
+            ops.append((kind, int(tokens[i + 1]), tokens[i + 2] + ' ' + tokens[i + 3]))
+            i += 4
+        else:
+            sys.exit('Cannot batch a trace with %s requests: %s' % (kind, path))
+    return tokens[:4], ops
+
+
+def continues(run, op):
+    """Can op join the run of requests run?"""
+    first = run[0]
+    return (op[0] == first[0] and op[0] in ('a', 'f') and
+            op[1] == first[1] + len(run) and op[2] == first[2])
+
+
+def flush(run, out):
+    kind, index, size = run[0]
+    if len(run) < MIN_RUN:
+        for op in run:
+            out.append(' '.join([op[0], str(op[1])] +
+                                ([str(op[2])] if op[0] != 'f' else [])))
+    elif kind == 'a':
+        out.append('A %d %d %d' % (index, len(run), size))
+    else:
+        out.append('F %d %d' % (index, len(run)))
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s <tracefile>' % sys.argv[0])
+    header, ops = read_ops(sys.argv[1])
+    out = []
+    run = []
+    for op in ops:
+        if run and not continues(run, op):
+            flush(run, out)
+            run = []
+        run.append(op)
+    if run:
+        flush(run, out)
+    header[2] = str(len(out))
+    print('\n'.join(header + out))
+
+
+if __name__ == '__main__':
+    main()
@@ -3,19 +3,75 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <stdint.h>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
 
 #include "./bfl.h"
 #include "./memlib.h"
+#include "./config.h"
 
 static void bfl_remove(binned_free_list* bfl, Node* node);
+static void bfl_keep_remainder(binned_free_list* bfl, void* ptr, size_t size);
 typedef enum {NOT_AVAILABLE, SPLIT_ABLE, SPLIT_UNABLE} block_type;
 
+#if BFL_GROW_MAX > 0
+// Pick the chunk for a growth: larger while the heap keeps growing
+static void bfl_grow_adapt(binned_free_list* bfl) {
+  if (bfl->mallocs - bfl->last_grow <= BFL_GROW_WINDOW) {
+    bfl->grow_chunk = (bfl->grow_chunk == 0) ? BFL_GROW_MIN : 2 * bfl->grow_chunk;
+  } else {
+    bfl->grow_chunk /= 2;
+    if (bfl->grow_chunk < BFL_GROW_MIN) bfl->grow_chunk = 0;
+  }
+  if (bfl->grow_chunk > BFL_GROW_MAX) bfl->grow_chunk = BFL_GROW_MAX;
+  if (bfl->grow_chunk > mem_region_size(bfl->region) / BFL_GROW_HEAP_SHARE) {
+    bfl->grow_chunk = mem_region_size(bfl->region) / BFL_GROW_HEAP_SHARE;
+  }
+  bfl->last_grow = bfl->mallocs;
+}
+#endif
+
+// How many bytes to grow the heap by beyond the delta it needs: enough to
+// make up the chunk, if what is left is worth a block
+static size_t bfl_grow_extra(binned_free_list* bfl, const size_t delta) {
+#if BFL_GROW_MAX > 0
+  bfl_grow_adapt(bfl);
+  if (bfl->grow_chunk >= delta + BFL_MIN_SPLIT) {
+    return ALIGN_WORD_FORWARD(bfl->grow_chunk - delta);
+  }
+#endif
+  return 0;
+}
+
+#if BFL_CALLOC_FRESH
+// node goes to the user, who may write all of it
+static inline void bfl_hand_out(binned_free_list* bfl, Node* node) {
+  char* end = (char*)node + GET_SIZE(node);
+  if (end > bfl->fresh) bfl->fresh = end;
+}
+
+// Zero n bytes of tags at p that are no longer a free block's, if they are
+// in the fresh memory
+static inline void bfl_scrub(binned_free_list* bfl, void* p, size_t n) {
+  if ((char*)p + n > bfl->fresh) memset(p, 0, n);
+}
+#else
+#define bfl_hand_out(bfl, node) ((void) 0)
+#define bfl_scrub(bfl, p, n) ((void) 0)
+#endif
+
+// The footer of the block before node and node's header and links, once
+// node is merged into that block
+#define BFL_SCRUB_TAGS(bfl, node) \
+  bfl_scrub(bfl, (block_header_right*)(node) - 1, sizeof(block_header_right) + FREE_NODE_SIZE)
+
 // alloc a block of value size, ensuring the returned address is 8-byte aligned
 // size must be a multiple of the word size (8 byte)
 static Node* bfl_alloc_aligned(binned_free_list* bfl, const size_t size) {
   assert(size < BFL_INSANITY_SIZE);
-  const void * lo = mem_heap_lo();
-  const void * hi = mem_heap_hi();
+  const void * lo = mem_region_lo(bfl->region);
+  const void * hi = mem_region_hi(bfl->region);
 
   Node* node;
   size_t delta;
@@ -25,41 +81,230 @@ static Node* bfl_alloc_aligned(binned_free_list* bfl, const size_t size) {
     node = ((block_header_right*)hi - 1)->left;
     bfl_remove(bfl, node);
     if (GET_SIZE(node) >= size) return node;
+    bfl_scrub(bfl, (block_header_right*)hi - 1, sizeof(block_header_right));
     delta = size - GET_SIZE(node);
   } else {
 	// The padding is to ensure the node address is 8-byte aligned
     const size_t padding = (void*) ALIGN_WORD_FORWARD(hi) - hi;
     delta = padding + size;
   }
-  
-  if (mem_sbrk(delta) == NULL) {
+
+  const size_t extra = bfl_grow_extra(bfl, delta);
+  if (mem_region_sbrk(bfl->region, delta + extra) == (void*) -1) {
     return NULL;
   }
+  BFL_STAT(bfl, sbrk_calls, 1);
+  BFL_STAT(bfl, sbrk_bytes, delta + extra);
   
   // Set up metadata for node
-  node = (Node*)(mem_heap_hi() - size);
+  node = (Node*)(mem_region_hi(bfl->region) - size - extra);
   SET_SIZE(node, size);
   SET_UNFREE(node);
   NODE_TO_RIGHT(node)->left = node;
+  if (extra > 0) bfl_keep_remainder(bfl, NODE_TO_RIGHT(node) + 1, extra);
   return node;
 }
 
-// Create a new binned free list
-binned_free_list bfl_new() {
+#ifdef BFL_PARAMS_RUNTIME
+bfl_params_t bfl_params = { BFL_MIN_BLOCK_SIZE, BFL_MIN_SPLIT_SIZE };
+
+// What bfl_params_load read, restored by every later call
+static bfl_params_t bfl_params_loaded;
+
+#ifdef BFL_TUNABLE
+// Set the parameter called name to value
+static void bfl_params_set(const char* name, const char* value) {
+  size_t v = ALIGN_WORD_FORWARD(strtoul(value, NULL, 0));
+  if (strcmp(name, "BFL_MIN_BLOCK_SIZE") == 0) {
+    bfl_params.min_block_size = v;
+  } else if (strcmp(name, "BFL_MIN_SPLIT_SIZE") == 0) {
+    bfl_params.min_split_size = v;
+  }
+}
+#endif
+
+// Keep the block layout valid: a block must hold its free node and its
+// right header, and stay word aligned
+void bfl_params_use(const bfl_params_t* p) {
+  bfl_params = *p;
+  bfl_params.min_block_size = ALIGN_WORD_FORWARD(bfl_params.min_block_size);
+  bfl_params.min_split_size = ALIGN_WORD_FORWARD(bfl_params.min_split_size);
+  if (bfl_params.min_block_size < FREE_NODE_SIZE + sizeof(block_header_right)) {
+    bfl_params.min_block_size = FREE_NODE_SIZE + sizeof(block_header_right);
+  }
+  if (bfl_params.min_split_size < bfl_params.min_block_size) {
+    bfl_params.min_split_size = bfl_params.min_block_size;
+  }
+}
+#endif
+
+// Read the tunable parameters: first the $BFL_CONFIG file, then the
+// environment. Only done once, since my_init runs inside the timed region;
+// later calls just go back to what was read.
+void bfl_params_load() {
+#ifdef BFL_PARAMS_RUNTIME
+  static bool loaded = false;
+  if (loaded) {
+    bfl_params = bfl_params_loaded;
+    return;
+  }
+  loaded = true;
+
+#ifdef BFL_TUNABLE
+  static const char* names[] = {"BFL_MIN_BLOCK_SIZE", "BFL_MIN_SPLIT_SIZE"};
+  const char* config = getenv("BFL_CONFIG");
+  FILE* f = (config != NULL) ? fopen(config, "r") : NULL;
+  if (f != NULL) {
+    char line[256];
+    while (fgets(line, sizeof(line), f) != NULL) {
+      char* eq = strchr(line, '=');
+      if (line[0] == '#' || eq == NULL) continue;
+      *eq = '\0';
+      bfl_params_set(line, eq + 1);
+    }
+    fclose(f);
+  }
+  for (size_t i = 0; i < sizeof(names) / sizeof(names[0]); i++) {
+    const char* value = getenv(names[i]);
+    if (value != NULL) bfl_params_set(names[i], value);
+  }
+#endif
+
+  bfl_params_use(&bfl_params);
+  bfl_params_loaded = bfl_params;
+#endif
+}
+
+// Create a new binned free list over the given memlib region
+binned_free_list bfl_new(int region) {
   binned_free_list bfl;
+  memset(&bfl, 0, sizeof(bfl));
   for (int i = 0; i < BFL_SIZE; i++) {
     bfl.lists[i] = NULL;
   }
+  bfl.region = region;
+#if BFL_CALLOC_FRESH
+  bfl.fresh = mem_region_clean(region);
+#endif
+#ifdef BFL_ADDRESS_ORDER
+  for (int i = 0; i < BFL_SIZE; i++) {
+    bfl.bins[i].policy = FIT_FIRST;
+  }
+#endif
+#ifdef BFL_SIDE_INDEX
+  // There is one binned free list per region, so its index can be static
+  static bfl_side side[MEM_REGIONS][BFL_SIZE];
+  for (int i = 0; i < BFL_SIZE; i++) {
+    side[region][i].n = 0;
+  }
+  bfl.side = side[region];
+#endif
   return bfl;
 }
 
+_Static_assert(BFL_MIN_BLOCK_SIZE >= FREE_NODE_SIZE + sizeof(block_header_right),
+               "BFL_MIN_BLOCK_SIZE can't hold a free node");
+
+#ifdef BFL_ADDRESS_ORDER
+
+#define SKIP_UP(node) (((skip_node*)(node))->up)
+
+// Level of node in the skip lists: one in four goes up each level
+static inline int bfl_skip_level(const Node* node) {
+  const uint32_t h = (uint32_t) ((((uintptr_t) node >> 3) * 0x9E3779B97F4A7C15ull) >> 32);
+  const int level = __builtin_ctz(h | (1u << 31)) / 2;
+  return (level < BFL_SKIP_LEVELS) ? level : BFL_SKIP_LEVELS - 1;
+}
+
+// Insert node into bin k in address order
+static void bfl_skip_insert(binned_free_list* bfl, const lgsize_t k, Node* node) {
+  const int level = bfl_skip_level(node);
+  Node* pred = NULL;  // NULL is the head
+  for (int l = BFL_SKIP_LEVELS - 1; l > 0; l--) {
+    Node* next = (pred != NULL) ? SKIP_UP(pred)[l - 1] : bfl->skip[k][l - 1];
+    while (next != NULL && next < node) {
+      pred = next;
+      next = SKIP_UP(next)[l - 1];
+    }
+    if (l <= level) {
+      SKIP_UP(node)[l - 1] = next;
+      if (pred != NULL) {
+        SKIP_UP(pred)[l - 1] = node;
+      } else {
+        bfl->skip[k][l - 1] = node;
+      }
+    }
+  }
+  Node* next = (pred != NULL) ? pred->next : bfl->lists[k];
+  while (next != NULL && next < node) {
+    pred = next;
+    next = next->next;
+  }
+  node->prev = pred;
+  node->next = next;
+  if (pred != NULL) {
+    pred->next = node;
+  } else {
+    bfl->lists[k] = node;
+  }
+  if (next != NULL) next->prev = node;
+}
+
+// Unlink node from the levels above 0 of bin k, if it is on any. The
+// search comes down from the top level, as in bfl_skip_insert.
+static void bfl_skip_remove(binned_free_list* bfl, const lgsize_t k, Node* node) {
+  const int level = bfl_skip_level(node);
+  if (level == 0) return;
+  Node* pred = NULL;  // NULL is the head
+  for (int l = BFL_SKIP_LEVELS - 1; l > 0; l--) {
+    Node* next = (pred != NULL) ? SKIP_UP(pred)[l - 1] : bfl->skip[k][l - 1];
+    while (next != NULL && next < node) {
+      pred = next;
+      next = SKIP_UP(next)[l - 1];
+    }
+    if (l > level) continue;
+    assert(next == node);
+    if (pred != NULL) {
+      SKIP_UP(pred)[l - 1] = SKIP_UP(node)[l - 1];
+    } else {
+      bfl->skip[k][l - 1] = SKIP_UP(node)[l - 1];
+    }
+  }
+}
+#endif
+
 // Remove a node from the binned free list
 static void bfl_remove(binned_free_list* bfl, Node* node) {
   if (!IS_FREE(node)) return;
+  if (node == bfl->victim) {
+    bfl->victim = NULL;
+    SET_UNFREE(node);
+    return;
+  }
+  const lgsize_t k = lg2_down(GET_SIZE(node));
+#ifdef BFL_SIDE_INDEX
+  if (node->next == BFL_SIDE_MARK) {
+    // Move the last slot into the hole
+    bfl_side* s = &bfl->side[k];
+    const int32_t slot = (int32_t)(uintptr_t) node->prev;
+    const int32_t last = --s->n;
+    if (slot != last) {
+      s->sizes[slot] = s->sizes[last];
+      s->nodes[slot] = s->nodes[last];
+      s->nodes[slot]->prev = (Node*)(uintptr_t) slot;
+    }
+    SET_UNFREE(node);
+    return;
+  }
+#endif
+#ifdef BFL_ADDRESS_ORDER
+  bfl_skip_remove(bfl, k, node);
+#endif
+  if (bfl->bins[k].rover == node) bfl->bins[k].rover = node->next;
   if (node->prev != NULL) {
     node->prev->next = node->next;
   } else {
-    bfl->lists[lg2_down(GET_SIZE(node))] = node->next;
+    bfl->lists[k] = node->next;
   }
   if (node->next) node->next->prev = node->prev;
   SET_UNFREE(node);
@@ -69,6 +314,21 @@ static void bfl_remove(binned_free_list* bfl, Node* node) {
 static void bfl_add_block(binned_free_list* bfl, Node* node) {
   const lgsize_t k = lg2_down(GET_SIZE(node));
   SET_FREE(node);
+#ifdef BFL_SIDE_INDEX
+  bfl_side* s = &bfl->side[k];
+  if (s->n < BFL_SIDE_CAP) {
+    const int32_t slot = s->n++;
+    s->sizes[slot] = GET_SIZE(node);
+    s->nodes[slot] = node;
+    node->next = BFL_SIDE_MARK;
+    node->prev = (Node*)(uintptr_t) slot;
+    return;
+  }
+#endif
+#ifdef BFL_ADDRESS_ORDER
+  bfl_skip_insert(bfl, k, node);
+  return;
+#endif
   node->prev = NULL;
   node->next = bfl->lists[k];
   if (bfl->lists[k] != NULL) {
@@ -78,7 +338,7 @@ static void bfl_add_block(binned_free_list* bfl, Node* node) {
 }
 
 // Wrap a Node object to ptr and add to binned free list
-static void bfl_add(binned_free_list* bfl, void* ptr, size_t size) {
+static inline void bfl_add(binned_free_list* bfl, void* ptr, size_t size) {
   assert(size < BFL_INSANITY_SIZE);
   Node* node = (Node*)ptr;
   SET_SIZE(node, size);
@@ -95,8 +355,8 @@ static void bfl_coalesce(binned_free_list* bfl, Node* node) {
   assert(IS_FREE(node));
   Node* left = node;
   block_header_right* right = NODE_TO_RIGHT(node);
-  const void* lo = mem_heap_lo();
-  const void* hi = mem_heap_hi();
+  const void* lo = mem_region_lo(bfl->region);
+  const void* hi = mem_region_hi(bfl->region);
 
   // Check for the block adjacent to the left of node
   Node* further_left;
@@ -107,6 +367,7 @@ static void bfl_coalesce(binned_free_list* bfl, Node* node) {
       bfl_remove(bfl, further_left);
       UP_SIZE(further_left, left);
       left = further_left;
+      BFL_STAT(bfl, coalesces, 1);
     }
   }
 
@@ -116,8 +377,11 @@ static void bfl_coalesce(binned_free_list* bfl, Node* node) {
     if ((void*)next_left < hi && (void*)(NODE_TO_RIGHT(next_left)+1) < hi && IS_FREE(next_left)) {
       UP_SIZE(left, next_left);
       bfl_remove(bfl, next_left);
+      BFL_SCRUB_TAGS(bfl, next_left);
+      BFL_STAT(bfl, coalesces, 1);
     }
   }
+  if (left != node) BFL_SCRUB_TAGS(bfl, node);
 
   NODE_TO_RIGHT(left)->left = left;
   bfl_add_block(bfl, left);
@@ -125,12 +389,13 @@ static void bfl_coalesce(binned_free_list* bfl, Node* node) {
 
 // Perform a block split
 static void bfl_block_split(binned_free_list* bfl, Node* node, const size_t size) {
-  assert(size >= BFL_MIN_BLOCK_SIZE);
+  assert(size >= BFL_MIN_BLOCK);
   assert(size < BFL_INSANITY_SIZE);
   assert(size < GET_SIZE(node));
   assert(GET_SIZE(node) < BFL_INSANITY_SIZE);
-  assert(GET_SIZE(node) >= size + BFL_MIN_SPLIT_SIZE);
-  
+  assert(GET_SIZE(node) >= size + BFL_MIN_SPLIT);
+  BFL_STAT(bfl, splits, 1);
+
   bfl_remove(bfl, node);
   block_header_right* right = NODE_TO_RIGHT(node);
 
@@ -143,16 +408,29 @@ static void bfl_block_split(binned_free_list* bfl, Node* node, const size_t size
   // reinsert right to bfl
   // size is the difference from the old right header to the new right header
   size_t right_size = (void*)right - (void*)mid_right;
-  assert(right_size >= BFL_MIN_BLOCK_SIZE);
-  bfl_add(bfl, (void*)(mid_right+1), right_size);
+  assert(right_size >= BFL_MIN_BLOCK);
+  bfl_keep_remainder(bfl, (void*)(mid_right+1), right_size);
+}
+
+// Make the free block of size bytes at ptr, left over by a split or a
+// growth, the designated victim, or add it to the bins
+static void bfl_keep_remainder(binned_free_list* bfl, void* ptr, size_t size) {
+#if BFL_VICTIM_MAX > 0
+  Node* remainder = (Node*)ptr;
+  if (bfl->victim != NULL) bfl_add_block(bfl, bfl->victim);
+  remainder->size = size | 1;
+  NODE_TO_RIGHT(remainder)->left = remainder;
+  bfl->victim = remainder;
+#else
+  bfl_add(bfl, ptr, size);
+#endif
 }
 
 // This helper function checks for what purpose we want to do with the block
 static block_type how_to_use_block(Node* const node, const size_t size) {
   if (node == NULL || GET_SIZE(node) < size) return NOT_AVAILABLE;  // can't use
-  if (GET_SIZE(node)-size >= BFL_MIN_SPLIT_SIZE) return SPLIT_ABLE;  // should split
-  if (GET_SIZE(node) > size) return SPLIT_UNABLE;  // don't need to split
-  return NOT_AVAILABLE;
+  if (GET_SIZE(node)-size >= BFL_MIN_SPLIT) return SPLIT_ABLE;  // should split
+  return SPLIT_UNABLE;  // don't need to split
 }
 
 // Can we use this block for allocating purpose?
@@ -161,42 +439,273 @@ static bool inline can_use_block(Node* const node, const size_t size) {
   return (answer != NOT_AVAILABLE);
 }
 
-// Malloc on bfl
-void* bfl_malloc(binned_free_list* bfl, size_t size) {
-  size += TOTAL_HEADER_SIZE;
-  if (size < BFL_MIN_BLOCK_SIZE) {
-    size = BFL_MIN_BLOCK_SIZE;
+#if BFL_FIT_ADAPTIVE && !defined(BFL_ADDRESS_ORDER)
+// End an epoch of bin b: pick the policy for the next one from what the
+// searches in this one cost and, if it was a best-fit epoch, gained.
+// Runs once per epoch, so it is kept out of line of the search.
+static __attribute__((noinline, cold)) void bfl_fit_adapt(bfl_bin* b) {
+  if (b->policy == FIT_BEST) {
+    // Best fit that saves less than 1/16 of the bytes asked for is not
+    // worth going on past the first fitting block
+    if (b->visited - b->depth > b->searches && b->saved * 16 < b->requested) {
+      b->policy = (b->depth > b->searches) ? FIT_NEXT : FIT_FIRST;
+      b->epochs = 0;
+    }
+  } else if (++b->epochs >= BFL_FIT_PROBE) {
+    b->policy = FIT_BEST;
   }
-  size = ALIGN_WORD_FORWARD(size);
-  
-  // We find the smallest level that one can use a free block
-  const lgsize_t k = lg2_up(size);
-  lgsize_t depth = k;
-  Node* node = bfl->lists[depth];
+  b->searches = 0;
+  b->visited = 0;
+  b->depth = 0;
+  b->requested = 0;
+  b->saved = 0;
+}
+#endif
+
+#ifdef BFL_SIDE_INDEX
+// Best fit over the index of bin k: the smallest size that fits, four
+// sizes at a time, then its slot. SSE2 has no 32-bit min, so it is a
+// compare and a select.
+static inline Node* bfl_fit_side(binned_free_list* bfl, const lgsize_t k,
+                                 const size_t size) {
+  const bfl_side* s = &bfl->side[k];
+  const int32_t want = (int32_t) size;
+  int32_t best = INT32_MAX;
+  int32_t i = 0;
+#ifdef __SSE2__
+  const __m128i want4 = _mm_set1_epi32(want - 1);
+  const __m128i none4 = _mm_set1_epi32(INT32_MAX);
+  __m128i best4 = none4;
+  for (; i + 4 <= s->n; i += 4) {
+    __m128i v = _mm_loadu_si128((const __m128i*)&s->sizes[i]);
+    __m128i fits = _mm_cmpgt_epi32(v, want4);
+    v = _mm_or_si128(_mm_and_si128(fits, v), _mm_andnot_si128(fits, none4));
+    __m128i less = _mm_cmplt_epi32(v, best4);
+    best4 = _mm_or_si128(_mm_and_si128(less, v), _mm_andnot_si128(less, best4));
+  }
+  int32_t lanes[4];
+  _mm_storeu_si128((__m128i*) lanes, best4);
+  for (int j = 0; j < 4; j++) {
+    if (lanes[j] < best) best = lanes[j];
+  }
+#endif
+  for (; i < s->n; i++) {
+    if (s->sizes[i] >= want && s->sizes[i] < best) best = s->sizes[i];
+  }
+  BFL_STAT(bfl, nodes_visited, s->n);
+  if (best == INT32_MAX) return NULL;
+  for (i = 0; s->sizes[i] != best; i++) {}
+  return s->nodes[i];
+}
+#endif
 
-  // At level k, one needs to check for all blocks
-  // Since blocks can have smaller size than the requested size
-  // That won't happen in higher levels
-  while (node != NULL && !can_use_block(node, size)) {
-    node = node->next;
+#ifdef BFL_ADDRESS_ORDER
+// First fit over the address-ordered bin k: its lowest block that fits
+static inline Node* bfl_fit_ordered(binned_free_list* bfl, const lgsize_t k,
+                                    const size_t size) {
+  uint32_t visited = 0;
+  Node* node;
+  for (node = bfl->lists[k]; node != NULL && GET_SIZE(node) < size; node = node->next) {
+    visited++;
   }
+  BFL_STAT(bfl, nodes_visited, visited);
+  return node;
+}
+#endif
 
-  // For level depth > k, simply checking if there's any free block suffices
-  if (!can_use_block(node, size)) {
-    while (depth < BFL_SIZE && !can_use_block(node, size)) {
-      node = bfl->lists[++depth];
+// Find a block of at least size bytes in bin k with the policy of the bin,
+// or return NULL
+static inline Node* bfl_fit(binned_free_list* bfl, const lgsize_t k, const size_t size) {
+#ifdef BFL_ADDRESS_ORDER
+  return bfl_fit_ordered(bfl, k, size);
+#else
+#ifdef BFL_SIDE_INDEX
+  Node* found = bfl_fit_side(bfl, k, size);
+  if (found != NULL || bfl->lists[k] == NULL) return found;
+#endif
+  bfl_bin* b = &bfl->bins[k];
+  Node* const head = bfl->lists[k];
+  Node* const start = (b->policy == FIT_NEXT && b->rover != NULL) ? b->rover : head;
+  Node* node;
+  uint32_t visited = 0;
+
+  // First block that fits; next fit starts at the rover and wraps around
+  for (node = start; node != NULL && !can_use_block(node, size); node = node->next) {
+    visited++;
+  }
+  if (node == NULL && start != head) {
+    for (node = head; node != start && !can_use_block(node, size); node = node->next) {
+      visited++;
     }
+    if (node == start) node = NULL;
   }
+#if BFL_FIT_ADAPTIVE
+  const uint32_t depth = visited;
+  size_t saved = 0;
+#endif
 
-  // A block has been found. We restrict to the smallest possible size block
-  if (node != NULL) {
-    Node * tmp_node = node->next;
-    for (tmp_node = node->next; tmp_node != NULL; tmp_node = tmp_node->next) {
+  // Best fit goes on to the smallest block that fits, up to an exact fit
+  if (node != NULL && b->policy == FIT_BEST) {
+#if BFL_FIT_ADAPTIVE
+    const size_t first = GET_SIZE(node);
+#endif
+    for (Node* tmp_node = node->next;
+         tmp_node != NULL && GET_SIZE(node) != size; tmp_node = tmp_node->next) {
+      visited++;
       if (GET_SIZE(tmp_node) < GET_SIZE(node) && can_use_block(tmp_node, size)) {
         node = tmp_node;
       }
     }
+#if BFL_FIT_ADAPTIVE
+    saved = first - GET_SIZE(node);
+#endif
+  }
+  if (b->policy == FIT_NEXT) b->rover = (node != NULL) ? node->next : NULL;
+  BFL_STAT(bfl, nodes_visited, visited);
+
+#if BFL_FIT_ADAPTIVE
+  if (b->policy == FIT_BEST) {
+    b->visited += visited;
+    b->depth += depth;
+    b->requested += size;
+    b->saved += saved;
+  }
+  if (++b->searches == BFL_FIT_EPOCH) bfl_fit_adapt(b);
+#endif
+  return node;
+#endif
+}
+
+#if BFL_HOT_SLOTS > 0
+// Give the blocks cached in slot h back to the bins
+static void bfl_hot_flush(binned_free_list* bfl, bfl_hot* h) {
+  while (h->stack != NULL) {
+    Node* node = h->stack;
+    h->stack = node->next;
+    SET_FREE(node);
+    bfl_coalesce(bfl, node);
+  }
+  bfl->hot_bytes -= h->cached * h->size;
+  h->cached = 0;
+}
+
+// Count a request for size (space-saving: a size not counted yet takes
+// over the slot with the smallest count, plus one) and return its slot
+static inline bfl_hot* bfl_hot_count(binned_free_list* bfl, const size_t size) {
+  bfl_hot* min = &bfl->hot[0];
+  bfl_hot* h = NULL;
+  for (int i = 0; i < BFL_HOT_SLOTS; i++) {
+    if (bfl->hot[i].size == size) {
+      h = &bfl->hot[i];
+      break;
+    }
+    if (bfl->hot[i].count < min->count) min = &bfl->hot[i];
+  }
+  if (h == NULL) {
+    bfl_hot_flush(bfl, min);
+    min->size = size;
+    min->error = min->count;
+    h = min;
+  }
+  h->count++;
+
+  if (++bfl->hot_requests == BFL_HOT_DECAY) {
+    bfl->hot_requests = 0;
+    for (int i = 0; i < BFL_HOT_SLOTS; i++) {
+      bfl->hot[i].count /= 2;
+      bfl->hot[i].error /= 2;
+    }
+  }
+  return h;
+}
+
+// Cache node as a block of size bytes if that size is hot and its stack
+// has room
+static inline bool bfl_hot_push(binned_free_list* bfl, Node* node, const size_t size) {
+  // A malloc pops the block as one of exactly this size
+  assert(size == GET_SIZE(node));
+  for (int i = 0; i < BFL_HOT_SLOTS; i++) {
+    bfl_hot* h = &bfl->hot[i];
+    if (h->size == size) {
+      if (h->count - h->error < BFL_HOT_MIN_COUNT || h->cached >= BFL_HOT_MAX_BLOCKS ||
+          (bfl->hot_bytes + size) * BFL_HOT_HEAP_SHARE > mem_region_size(bfl->region)) {
+        return false;
+      }
+      node->next = h->stack;
+      h->stack = node;
+      h->cached++;
+      bfl->hot_bytes += size;
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+// The size of the block that serves a malloc of size bytes
+static inline size_t bfl_block_size(size_t size) {
+  size += TOTAL_HEADER_SIZE;
+  if (size < BFL_MIN_BLOCK) {
+    size = BFL_MIN_BLOCK;
+  }
+  return ALIGN_WORD_FORWARD(size);
+}
+
+// Malloc on bfl
+void* bfl_malloc(binned_free_list* bfl, size_t size) {
+  size = bfl_block_size(size);
+
+  BFL_STAT(bfl, mallocs, 1);
+  bfl->mallocs++;
+
+#if BFL_HOT_SLOTS > 0
+  bfl_hot* h = bfl_hot_count(bfl, size);
+  if (h->stack != NULL) {
+    Node* node = h->stack;
+    h->stack = node->next;
+    h->cached--;
+    bfl->hot_bytes -= size;
+    BFL_STAT(bfl, hot_hits, 1);
+    return (void*)((external_node*)node + 1);
+  }
+#endif
+
+#if BFL_VICTIM_MAX > 0
+  // Small requests come from the designated victim first
+  Node* victim = bfl->victim;
+  if (victim != NULL && size <= BFL_VICTIM_MAX + TOTAL_HEADER_SIZE &&
+      GET_SIZE(victim) >= size) {
+    if (GET_SIZE(victim) - size >= BFL_MIN_SPLIT) {
+      bfl_block_split(bfl, victim, size);
+    } else {
+      bfl_remove(bfl, victim);
+    }
+    BFL_STAT(bfl, victim_hits, 1);
+    bfl_hand_out(bfl, victim);
+    return (void*)((external_node*)victim + 1);
+  }
+#endif
+
+  // We start at the level of blocks of this very size. At level k, one
+  // needs to check the blocks, since they can be smaller than requested.
+  // That won't happen in higher levels, so the first non-empty one will do.
+  const lgsize_t k = lg2_down(size);
+  lgsize_t depth = k;
+  Node* node = bfl_fit(bfl, k, size);
+  while (node == NULL && ++depth < BFL_SIZE) {
+#ifdef BFL_SIDE_INDEX
+    if (bfl->side[depth].n > 0 || bfl->lists[depth] != NULL)
+#else
+    if (bfl->lists[depth] != NULL)
+#endif
+      node = bfl_fit(bfl, depth, size);
   }
+#if BFL_VICTIM_MAX > 0
+  // Larger requests only get the victim when no bin can serve them
+  if (node == NULL && bfl->victim != NULL && GET_SIZE(bfl->victim) >= size) {
+    node = bfl->victim;
+  }
+#endif
 
   switch (how_to_use_block(node, size)) {
     case NOT_AVAILABLE:
@@ -219,17 +728,201 @@ void* bfl_malloc(binned_free_list* bfl, size_t size) {
   SET_UNFREE(node);
   assert(NODE_TO_RIGHT(node)->left == node);
   assert(IS_WORD_ALIGNED((void*)((external_node*)node + 1)));
+  bfl_hand_out(bfl, node);
   return (void*)((external_node*)node + 1);
 }
 
+// Zero n bytes at p, with non-temporal stores from BFL_ZERO_STREAM bytes
+// up so that a large block doesn't evict the cache
+static void bfl_zero(char* p, size_t n) {
+#ifdef __SSE2__
+  if (n >= BFL_ZERO_STREAM) {
+    char* a = (char*)ALIGN_FORWARD(p, 16);
+    memset(p, 0, a - p);
+    n -= a - p;
+    const __m128i zero = _mm_setzero_si128();
+    for (; n >= 64; n -= 64, a += 64) {
+      _mm_stream_si128((__m128i*)a, zero);
+      _mm_stream_si128((__m128i*)a + 1, zero);
+      _mm_stream_si128((__m128i*)a + 2, zero);
+      _mm_stream_si128((__m128i*)a + 3, zero);
+    }
+    _mm_sfence();
+    p = a;
+  }
+#endif
+  memset(p, 0, n);
+}
+
+// Malloc, zeroing the bytes below fresh as it was before the malloc: the
+// malloc may move it past the block
+void* bfl_calloc(binned_free_list* bfl, size_t size) {
+#if BFL_CALLOC_FRESH
+  const char* fresh = bfl->fresh;
+#endif
+  char* p = bfl_malloc(bfl, size);
+  if (p == NULL) return NULL;
+  char* end = p + size;
+#if BFL_CALLOC_FRESH
+  // Above fresh, only the links of the free block p was carved from
+  const char* links = (char*)((external_node*)p - 1) + FREE_NODE_SIZE;
+  if (fresh < links) fresh = links;
+  if ((char*)fresh < end) end = (char*)fresh;
+#endif
+  BFL_STAT(bfl, calloc_bytes, size);
+  if (end > p) {
+    BFL_STAT(bfl, calloc_zeroed, end - p);
+    bfl_zero(p, end - p);
+  }
+  return p;
+}
+
+// Where the aligned payload of a block carved from node starts. Its lead,
+// the bytes before it, is empty, a free block of its own, or given to the
+// left neighbour; a node at the start of the region has no neighbour to
+// take a lead smaller than a block.
+static inline char* bfl_align_payload(binned_free_list* bfl, Node* node,
+                                      const size_t alignment) {
+  char* ptr = (char*)((external_node*)node + 1);
+  char* p = (char*) ALIGN_FORWARD(ptr, alignment);
+  if ((void*)node == mem_region_lo(bfl->region)) {
+    while (p != ptr && (size_t)(p - ptr) < BFL_MIN_BLOCK) p += alignment;
+  }
+  return p;
+}
+
+// Can node hold a block of size bytes with an aligned payload?
+static inline bool bfl_align_fits(binned_free_list* bfl, Node* node,
+                                  const size_t alignment, const size_t size) {
+  const char* p = bfl_align_payload(bfl, node, alignment);
+  return (size_t)(p - (char*)((external_node*)node + 1)) + size <= GET_SIZE(node);
+}
+
+// First fit of an aligned block of size bytes over the bins from size's
+// up, looking at no more than BFL_ALIGN_SCAN blocks of each, then the
+// designated victim
+static Node* bfl_fit_aligned(binned_free_list* bfl, const size_t alignment,
+                             const size_t size) {
+  for (lgsize_t k = lg2_down(size); k < BFL_SIZE; k++) {
+    int scan = BFL_ALIGN_SCAN;
+#ifdef BFL_SIDE_INDEX
+    for (int32_t i = 0; i < bfl->side[k].n && scan > 0; i++, scan--) {
+      if (bfl_align_fits(bfl, bfl->side[k].nodes[i], alignment, size)) {
+        return bfl->side[k].nodes[i];
+      }
+    }
+#endif
+    for (Node* node = bfl->lists[k]; node != NULL && scan > 0; node = node->next, scan--) {
+      if (bfl_align_fits(bfl, node, alignment, size)) return node;
+    }
+    BFL_STAT(bfl, nodes_visited, BFL_ALIGN_SCAN - scan);
+  }
+#if BFL_VICTIM_MAX > 0
+  if (bfl->victim != NULL && bfl_align_fits(bfl, bfl->victim, alignment, size)) {
+    return bfl->victim;
+  }
+#endif
+  return NULL;
+}
+
+// Add lead bytes at the end of node's left neighbour, which stays in its
+// bin if it is free
+static void bfl_give_left(binned_free_list* bfl, Node* node, const size_t lead) {
+  Node* left = ((block_header_right*)node - 1)->left;
+  const bool free = IS_FREE(left);
+  if (free) bfl_remove(bfl, left);
+  left->size += lead;
+  NODE_TO_RIGHT(left)->left = left;
+  if (free) bfl_add_block(bfl, left);
+}
+
+// Malloc size bytes aligned to alignment, a power of two. A free block
+// that can hold the aligned payload is used if the bins have one;
+// otherwise bfl_malloc gets a block with room for any lead. The lead goes
+// to a free block of its own or to the left neighbour, and a tail that
+// can be split off back to the bins, so that alignment wastes no memory.
+void* bfl_memalign(binned_free_list* bfl, size_t alignment, size_t size) {
+  if (alignment <= WORD_ALIGN) return bfl_malloc(bfl, size);
+  const size_t need = bfl_block_size(size);
+  Node* node = bfl_fit_aligned(bfl, alignment, need);
+  if (node != NULL) {
+    BFL_STAT(bfl, mallocs, 1);
+    bfl->mallocs++;
+    bfl_remove(bfl, node);
+  } else {
+    char* ptr = bfl_malloc(bfl, size + alignment - WORD_ALIGN);
+    if (ptr == NULL) return NULL;
+    node = (Node*)((external_node*)ptr - 1);
+    if (!bfl_align_fits(bfl, node, alignment, need)) {
+      // The first block of the region, where the lead must be a block
+      bfl_free(bfl, ptr);
+      ptr = bfl_malloc(bfl, size + alignment + BFL_MIN_BLOCK);
+      if (ptr == NULL) return NULL;
+      node = (Node*)((external_node*)ptr - 1);
+    }
+  }
+
+  char* p = bfl_align_payload(bfl, node, alignment);
+  const size_t lead = p - (char*)((external_node*)node + 1);
+  assert(lead + need <= GET_SIZE(node));
+  if (lead > 0) {
+    Node* aligned = (Node*)((external_node*)p - 1);
+    aligned->size = GET_SIZE(node) - lead;
+    NODE_TO_RIGHT(aligned)->left = aligned;
+    if (lead >= BFL_MIN_BLOCK) {
+      node->size = lead;
+      NODE_TO_RIGHT(node)->left = node;
+      SET_FREE(node);
+      bfl_coalesce(bfl, node);
+    } else {
+      bfl_give_left(bfl, node, lead);
+    }
+    BFL_STAT(bfl, splits, 1);
+    node = aligned;
+  }
+
+  if (GET_SIZE(node) - need >= BFL_MIN_BLOCK) {
+    Node* tail = (Node*)((char*)node + need);
+    tail->size = GET_SIZE(node) - need;
+    NODE_TO_RIGHT(tail)->left = tail;
+    node->size = need;
+    NODE_TO_RIGHT(node)->left = node;
+    SET_FREE(tail);
+    bfl_coalesce(bfl, tail);
+    BFL_STAT(bfl, splits, 1);
+  }
+  assert(ALIGNED(p, alignment));
+  bfl_hand_out(bfl, node);
+  return p;
+}
+
 // Free a block
 void bfl_free(binned_free_list* bfl, void* ptr) {
   if (ptr == NULL) return;
   Node* node = (Node*)((external_node*)ptr - 1);
+#if BFL_HOT_SLOTS > 0
+  if (bfl_hot_push(bfl, node, GET_SIZE(node))) return;
+#endif
   SET_FREE(node);
   bfl_coalesce(bfl, node);
 }
 
+// Free a block of a malloc of size bytes. This is a thin wrapper of
+// bfl_free: the header is read all the same, because a block handed out
+// unsplit, or shrunk in place by realloc, is larger than the class of its
+// size, and the hot caches and bfl_coalesce need the block's own size.
+// Debug builds check that the size fits the block.
+void bfl_free_sized(binned_free_list* bfl, void* ptr, size_t size) {
+#ifndef BFL_ADAPTIVE
+  // Under ADAPTIVE, a block malloc'd before the switch to a profile's
+  // parameters can be smaller than the class of its size now
+  assert(ptr == NULL ||
+         bfl_block_size(size) <= GET_SIZE(((Node*)((external_node*)ptr - 1))));
+#endif
+  (void) size;
+  bfl_free(bfl, ptr);
+}
+
 // Realloc a block
 void* bfl_realloc(binned_free_list* bfl, void* ptr, const size_t orig_size) {
   // If the original node is NULL, we need to allocate a new node
@@ -244,18 +937,20 @@ void* bfl_realloc(binned_free_list* bfl, void* ptr, const size_t orig_size) {
 
   size_t size = orig_size + TOTAL_HEADER_SIZE;
   size = ALIGN_WORD_FORWARD(size);
-  if (size < BFL_MIN_BLOCK_SIZE) {
-    size = BFL_MIN_BLOCK_SIZE;
+  if (size < BFL_MIN_BLOCK) {
+    size = BFL_MIN_BLOCK;
   }
 
   // We coalesce before checking
   Node* node = (Node*)((external_node*)ptr - 1);
   Node* next_left = (Node*)(NODE_TO_RIGHT(node)+1);
-  void* hi = mem_heap_hi();
+  void* hi = mem_region_hi(bfl->region);
   if ((void*)next_left < hi && IS_FREE(next_left)) {
     bfl_remove(bfl, next_left);
     UP_SIZE(node, next_left);
+    BFL_SCRUB_TAGS(bfl, next_left);
     NODE_TO_RIGHT(node)->left = node;
+    BFL_STAT(bfl, coalesces, 1);
   }
 
   switch(how_to_use_block(node, size)) {
@@ -268,16 +963,22 @@ void* bfl_realloc(binned_free_list* bfl, void* ptr, const size_t orig_size) {
       // Check for end of block.
       // Splitting like this is not really optimal, but it's too late to change
 	  if (hi - GET_SIZE(node) == (void*)node) {
+        if (mem_region_sbrk(bfl->region, size - node->size) == (void*) -1) return NULL;
         NODE_TO_RIGHT(node)->left = NULL;
-        mem_sbrk(size - node->size);
+        BFL_STAT(bfl, sbrk_calls, 1);
+        BFL_STAT(bfl, sbrk_bytes, size - node->size);
+        BFL_STAT(bfl, realloc_in_place, 1);
         SET_SIZE(node, size);
         NODE_TO_RIGHT(node)->left = node;
+        bfl_hand_out(bfl, node);
         return ptr;
       }
 
       // Normal malloc
       void* new_ptr = bfl_malloc(bfl, orig_size);
       memcpy(new_ptr, ptr, GET_SIZE(node) - TOTAL_HEADER_SIZE);
+      BFL_STAT(bfl, realloc_copies, 1);
+      BFL_STAT(bfl, realloc_bytes_copied, GET_SIZE(node) - TOTAL_HEADER_SIZE);
       bfl_free(bfl, ptr);
       assert(IS_WORD_ALIGNED(new_ptr));
       return new_ptr;
@@ -290,7 +991,77 @@ void* bfl_realloc(binned_free_list* bfl, void* ptr, const size_t orig_size) {
       // return the old block
       break;
   }
+  BFL_STAT(bfl, realloc_in_place, 1);
   SET_UNFREE(node);
+  bfl_hand_out(bfl, node);
   assert(IS_WORD_ALIGNED(ptr));
   return ptr;
 }
+
+// Malloc n blocks of size bytes. Each group of blocks that fits in
+// BFL_BATCH_BYTES is one bfl_malloc of their total, split into the blocks
+// in place; the last block of a group keeps what is left over.
+size_t bfl_malloc_batch(binned_free_list* bfl, size_t size, size_t n, void** out) {
+  size = bfl_block_size(size);
+
+  const size_t group = (size < BFL_BATCH_BYTES) ? BFL_BATCH_BYTES / size : 1;
+  size_t done = 0;
+  while (done < n) {
+    const size_t m = (n - done < group) ? n - done : group;
+    void* ptr = bfl_malloc(bfl, m * size - TOTAL_HEADER_SIZE);
+    if (ptr == NULL) break;
+    Node* node = (Node*)((external_node*)ptr - 1);
+    size_t left = GET_SIZE(node);
+    for (size_t i = 0; i < m; i++) {
+      const size_t block = (i == m - 1) ? left : size;
+      node->size = block;
+      NODE_TO_RIGHT(node)->left = node;
+      out[done++] = (void*)((external_node*)node + 1);
+      left -= block;
+      node = (Node*)(NODE_TO_RIGHT(node) + 1);
+    }
+    BFL_STAT(bfl, splits, m - 1);
+  }
+  return done;
+}
+
+static int bfl_ptr_cmp(const void* a, const void* b) {
+  const uintptr_t x = (uintptr_t) *(void* const*) a;
+  const uintptr_t y = (uintptr_t) *(void* const*) b;
+  return (x > y) - (x < y);
+}
+
+// Free n blocks. Runs of blocks adjacent in the heap become one free
+// block before it is coalesced with its neighbours and binned, instead of
+// each block being binned and then taken out again by the next.
+void bfl_free_batch(binned_free_list* bfl, void** ptrs, size_t n) {
+  if (n <= BFL_BATCH_INSERTION) {
+    for (size_t i = 1; i < n; i++) {
+      void* p = ptrs[i];
+      size_t j = i;
+      for (; j > 0 && ptrs[j - 1] > p; j--) {
+        ptrs[j] = ptrs[j - 1];
+      }
+      ptrs[j] = p;
+    }
+  } else {
+    qsort(ptrs, n, sizeof(void*), bfl_ptr_cmp);
+  }
+
+  size_t i = 0;
+  while (i < n && ptrs[i] == NULL) i++;
+  while (i < n) {
+    Node* first = (Node*)((external_node*)ptrs[i] - 1);
+    Node* end = (Node*)(NODE_TO_RIGHT(first) + 1);
+    size_t size = GET_SIZE(first);
+    for (i++; i < n && (Node*)((external_node*)ptrs[i] - 1) == end; i++) {
+      size += GET_SIZE(end);
+      end = (Node*)(NODE_TO_RIGHT(end) + 1);
+      BFL_STAT(bfl, coalesces, 1);
+    }
+    first->size = size;
+    SET_FREE(first);
+    NODE_TO_RIGHT(first)->left = first;
+    bfl_coalesce(bfl, first);
+  }
+}
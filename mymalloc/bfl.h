@@ -3,13 +3,62 @@
 
 #include <stdbool.h>
 
+// Values picked by opentuner_run.py --freeze, for a production build (make FROZEN=1)
+#ifdef BFL_FROZEN
+#include "./tuned_params.h"
+#endif
+
+// Switching parameter sets at runtime needs them to be variables, but not
+// reading them from the environment like BFL_TUNABLE
+#if defined(BFL_TUNABLE) || defined(BFL_ADAPTIVE)
+#define BFL_PARAMS_RUNTIME
+#endif
+
 #define BFL_INSANITY_SIZE (1 << 25)
+#ifndef BFL_MIN_BLOCK_SIZE
 #define BFL_MIN_BLOCK_SIZE 64
-#define BFL_MIN_SPLIT_SIZE 2*BFL_MIN_BLOCK_SIZE
+#endif
+#ifndef BFL_MIN_SPLIT_SIZE
+#define BFL_MIN_SPLIT_SIZE (2*BFL_MIN_BLOCK_SIZE)
+#endif
 #define BFL_MIN_LG 6
 #define BFL_SIZE 26
 #define WORD_ALIGN 8
 
+// bfl_params_use enforces these at runtime; a compile-time value that
+// breaks them would not be the configuration that was tuned
+#if BFL_MIN_BLOCK_SIZE % WORD_ALIGN != 0 || BFL_MIN_SPLIT_SIZE % WORD_ALIGN != 0
+#error "BFL_MIN_BLOCK_SIZE and BFL_MIN_SPLIT_SIZE must be multiples of WORD_ALIGN"
+#endif
+#if BFL_MIN_SPLIT_SIZE < BFL_MIN_BLOCK_SIZE
+#error "BFL_MIN_SPLIT_SIZE can't be less than BFL_MIN_BLOCK_SIZE"
+#endif
+
+/*
+ * Tunable parameters. Normally these are the compile-time constants above.
+ * Built with -DBFL_TUNABLE (make TUNABLE=1) they are read at runtime by
+ * bfl_params_load instead, from environment variables of the same name or
+ * from the NAME=value lines of the file named by $BFL_CONFIG, so that
+ * OpenTuner can try a configuration without recompiling. Built with
+ * -DBFL_ADAPTIVE (make ADAPTIVE=1) they are variables too, starting from
+ * the constants unless BFL_TUNABLE is also set, and allocator.c may
+ * switch to a set tuned for the workload it recognises, with
+ * bfl_params_use.
+ */
+typedef struct {
+  size_t min_block_size;  // BFL_MIN_BLOCK_SIZE
+  size_t min_split_size;  // BFL_MIN_SPLIT_SIZE
+} bfl_params_t;
+
+#ifdef BFL_PARAMS_RUNTIME
+extern bfl_params_t bfl_params;
+#define BFL_MIN_BLOCK (bfl_params.min_block_size)
+#define BFL_MIN_SPLIT (bfl_params.min_split_size)
+#else
+#define BFL_MIN_BLOCK ((size_t) BFL_MIN_BLOCK_SIZE)
+#define BFL_MIN_SPLIT ((size_t) BFL_MIN_SPLIT_SIZE)
+#endif
+
 #define ALIGNED(x, alignment) ((((uint64_t)x) & ((alignment)-1)) == 0)
 #define ALIGN_FORWARD(x, alignment) \
     ((((uint64_t)x) + ((alignment)-1)) & (~((uint64_t)(alignment)-1)))
@@ -59,35 +108,304 @@ typedef struct block_header_right {
 
 #define TOTAL_HEADER_SIZE (sizeof(external_node)+sizeof(block_header_right))
 
+/*
+ * Counters of what the binned free list did, for my_stats.
+ * Only compiled in with -DBFL_STATS (make STATS=1); otherwise BFL_STAT is a no-op.
+ */
+#ifdef BFL_STATS
+typedef struct {
+  size_t mallocs;
+  size_t nodes_visited;
+  size_t splits;
+  size_t coalesces;
+  size_t sbrk_calls;
+  size_t sbrk_bytes;
+  size_t realloc_in_place;
+  size_t realloc_copies;
+  size_t realloc_bytes_copied;
+  size_t hot_hits;
+  size_t victim_hits;
+  size_t calloc_bytes;
+  size_t calloc_zeroed;
+} bfl_stats;
+
+#define BFL_STAT(bfl, field, n) ((bfl)->stats.field += (n))
+#else
+#define BFL_STAT(bfl, field, n) ((void) 0)
+#endif
+
+/*
+ * Fit policy of a bin. Best fit scans the whole bin for the smallest block
+ * that fits; first fit takes the first that fits; next fit is first fit
+ * starting where the last search of the bin stopped.
+ *
+ * With -D BFL_FIT_ADAPTIVE=1 each bin starts with best fit and
+ * measures, over epochs of BFL_FIT_EPOCH searches, how many nodes it
+ * visits and how many bytes best fit saved over taking the first block
+ * that fits. When best fit costs scanning but hardly saves anything, e.g.
+ * blocks of one size, the bin moves to first fit, or to next fit if the
+ * first fitting block tends to be deep in the list. Every BFL_FIT_PROBE
+ * epochs it goes back to best fit for an epoch to measure again.
+ * Off by default, so every bin is best fit: on traces/ it visits fewer
+ * nodes, but Kops/sec is the same within noise and util 0.3 points lower.
+ */
+#ifndef BFL_FIT_ADAPTIVE
+#define BFL_FIT_ADAPTIVE 0
+#endif
+#define BFL_FIT_EPOCH 64
+#define BFL_FIT_PROBE 16
+
+typedef enum {
+  FIT_BEST,
+  FIT_FIRST,
+  FIT_NEXT
+} fit_policy;
+
+typedef struct {
+  Node* rover;        // where next fit resumes, or NULL for the head
+  uint8_t policy;     // a fit_policy
+  uint8_t epochs;     // epochs since the last best-fit epoch
+  uint16_t searches;  // searches of this bin in the current epoch
+  uint32_t visited;   // nodes visited by them
+  uint32_t depth;     // nodes before the first fitting one, summed
+  size_t requested;   // bytes requested by them
+  size_t saved;       // bytes best fit saved over first fit
+} bfl_bin;
+
+/*
+ * Hot-size caches. A space-saving counter over BFL_HOT_SLOTS slots tracks
+ * the most requested block sizes. A size counted at least BFL_HOT_MIN_COUNT
+ * times keeps up to BFL_HOT_MAX_BLOCKS freed blocks of exactly that size on
+ * a stack of its own, uncoalesced and still marked in use, so that the
+ * next request for it pops one without searching, splitting or
+ * coalescing. The stacks together hold at most 1/BFL_HOT_HEAP_SHARE of
+ * the heap, since what they hold can't be merged. Counts are halved every
+ * BFL_HOT_DECAY requests, and a size pushed out of the counter returns its
+ * blocks to the bins, so the caches follow the hot set as it changes.
+ *
+ * Off by default (build with PARAMS="-D BFL_HOT_SLOTS=8"): on the traces
+ * the bin search is already short, and keeping the counter costs more
+ * than the search it saves, except on trace_c9.
+ */
+#ifndef BFL_HOT_SLOTS
+#define BFL_HOT_SLOTS 0
+#endif
+#ifndef BFL_HOT_MIN_COUNT
+#define BFL_HOT_MIN_COUNT 32
+#endif
+#ifndef BFL_HOT_MAX_BLOCKS
+#define BFL_HOT_MAX_BLOCKS 32
+#endif
+#ifndef BFL_HOT_HEAP_SHARE
+#define BFL_HOT_HEAP_SHARE 64
+#endif
+#define BFL_HOT_DECAY 4096
+
+typedef struct {
+  size_t size;        // block size counted in this slot, or 0
+  uint32_t count;     // estimate of the requests for it
+  uint32_t error;     // by how much count may overestimate them
+  uint32_t cached;    // blocks on the stack
+  Node* stack;        // linked through next
+} bfl_hot;
+
+/*
+ * Out-of-band index of the free blocks. With -DBFL_SIDE_INDEX (make
+ * SIDE_INDEX=1) each bin keeps the sizes and addresses of up to
+ * BFL_SIDE_CAP of its free blocks in two dense arrays outside the heap,
+ * so that the fit search compares contiguous sizes (vectorized by gcc)
+ * instead of chasing next pointers through the heap, and only touches the
+ * block it picks. An indexed block has next == BFL_SIDE_MARK and its slot
+ * in prev; blocks beyond BFL_SIDE_CAP go on the bin's list as usual.
+ * Indexed bins always use best fit.
+ */
+#ifdef BFL_SIDE_INDEX
+#ifndef BFL_SIDE_CAP
+#define BFL_SIDE_CAP 256
+#endif
+#define BFL_SIDE_MARK ((Node*) 1)
+
+typedef struct {
+  int32_t n;                     // slots in use
+  int32_t sizes[BFL_SIDE_CAP];   // GET_SIZE of each block
+  Node* nodes[BFL_SIDE_CAP];
+} bfl_side;
+#endif
+
+/*
+ * Address-ordered bins. With -DBFL_ADDRESS_ORDER (make ADDRESS_ORDER=1)
+ * each bin is kept sorted by address and searched first fit, so malloc
+ * takes the lowest block that fits, which keeps the heap compact and
+ * leaves the free space at its top to coalesce. A bin is a skip list of
+ * BFL_SKIP_LEVELS levels: level 0 is the usual next/prev list, and a free
+ * block on level l > 0 also holds its forward pointer of that level in
+ * skip_node.up, after its Node. A block's level comes from a hash of its
+ * address (one in four goes up a level), so insertion and removal take
+ * O(log n) without any state of their own. Not with BFL_SIDE_INDEX.
+ */
+#ifdef BFL_ADDRESS_ORDER
+#ifdef BFL_SIDE_INDEX
+#error "BFL_ADDRESS_ORDER and BFL_SIDE_INDEX can't be combined"
+#endif
+#define BFL_SKIP_LEVELS 5
+
+typedef struct {
+  Node node;
+  Node* up[BFL_SKIP_LEVELS - 1];  // next block on levels 1 and up
+} skip_node;
+
+#define FREE_NODE_SIZE sizeof(skip_node)
+#else
+#define FREE_NODE_SIZE sizeof(Node)
+#endif
+
+/*
+ * Designated victim (dlmalloc's "last remainder"). The remainder of the
+ * last split is kept out of the bins, and a request of up to
+ * BFL_VICTIM_MAX bytes is carved from it before any bin is searched, so
+ * that runs of small allocations are contiguous and cost no bin
+ * operations. The victim is free, so its neighbours coalesce with it as
+ * usual; a new remainder sends the old victim to its bin.
+ * Off by default: -D BFL_VICTIM_MAX=4096 raises Kops/sec on traces/ by about
+ * 15%, but costs 1.6 points of utilization.
+ */
+#ifndef BFL_VICTIM_MAX
+#define BFL_VICTIM_MAX 0
+#endif
+
+/*
+ * Heap growth. When no free block fits, bfl_alloc_aligned grows the heap
+ * by at least the current chunk, and the slack past the request becomes a
+ * free block at the top of the heap (the designated victim, if enabled)
+ * that the next requests are carved from. The chunk doubles from
+ * BFL_GROW_MIN up to BFL_GROW_MAX while the heap grows again within
+ * BFL_GROW_WINDOW mallocs, and halves otherwise. It is also capped at
+ * 1/BFL_GROW_HEAP_SHARE of the heap. Off by default, so the heap grows by
+ * exactly what is missing: -D BFL_GROW_MAX=65536 halves the mem_sbrk calls
+ * on traces/, but costs 0.9 points of utilization for no gain in Kops/sec.
+ */
+#ifndef BFL_GROW_MAX
+#define BFL_GROW_MAX 0
+#endif
+#ifndef BFL_GROW_HEAP_SHARE
+#define BFL_GROW_HEAP_SHARE 64
+#endif
+#define BFL_GROW_MIN 512
+#define BFL_GROW_WINDOW 64
+
+/*
+ * Batches. bfl_malloc_batch takes at most BFL_BATCH_BYTES at a time from
+ * the bins, so that a large batch doesn't need a free block as large.
+ * bfl_free_batch sorts up to BFL_BATCH_INSERTION pointers by insertion
+ * sort, since they mostly come in address order, and more with qsort.
+ */
+#define BFL_BATCH_BYTES (64 << 10)
+#define BFL_BATCH_INSERTION 32
+
+/*
+ * Aligned mallocs. bfl_memalign looks at up to BFL_ALIGN_SCAN free blocks
+ * of each bin for one that can hold the aligned payload before it takes
+ * a larger block from bfl_malloc.
+ */
+#ifndef BFL_ALIGN_SCAN
+#define BFL_ALIGN_SCAN 16
+#endif
+
+/*
+ * Callocs. Memory the region has not handed out since mem_init reads as
+ * zero, like fresh pages. With BFL_CALLOC_FRESH (the default) fresh marks
+ * where that memory starts; above it only the boundary tags and links of
+ * free blocks have been written, so bfl_calloc zeroes only what of a block
+ * lies below fresh, and those links. Zeroing of BFL_ZERO_STREAM bytes or
+ * more uses non-temporal stores, which don't evict the cache for it.
+ */
+#ifndef BFL_CALLOC_FRESH
+#define BFL_CALLOC_FRESH 1
+#endif
+#ifndef BFL_ZERO_STREAM
+#define BFL_ZERO_STREAM (1 << 20)
+#endif
+
 /*
  * The binned_free_list is an array of free nodes
  * The k-th level contains nodes of size up to 2^k, but more than 2^(k - 1) (including headers)
  */
 typedef struct {
   Node* lists[BFL_SIZE];
+  bfl_bin bins[BFL_SIZE];
+  int region;             // the memlib region the blocks come from
+  Node* victim;           // the designated victim, free but in no bin
+  size_t grow_chunk;      // least the heap grows by, 0 for exactly
+  uint32_t mallocs;       // calls to bfl_malloc
+  uint32_t last_grow;     // mallocs at the last growth
+#ifdef BFL_SIDE_INDEX
+  bfl_side* side;         // BFL_SIZE of them
+#endif
+#ifdef BFL_ADDRESS_ORDER
+  Node* skip[BFL_SIZE][BFL_SKIP_LEVELS - 1];  // heads of levels 1 and up
+#endif
+#if BFL_HOT_SLOTS > 0
+  bfl_hot hot[BFL_HOT_SLOTS];
+  uint32_t hot_requests;  // since the counts were last halved
+  size_t hot_bytes;       // in all the stacks
+#endif
+#if BFL_CALLOC_FRESH
+  char* fresh;            // zero from here up, but for free blocks' tags
+#endif
+#ifdef BFL_STATS
+  bfl_stats stats;
+#endif
 } binned_free_list;
 
-// create a binned free list
-binned_free_list bfl_new();
+// read the tunable parameters (once), or go back to what was read; does
+// nothing unless they are variables
+void bfl_params_load();
+
+#ifdef BFL_PARAMS_RUNTIME
+// use the parameters p from now on, adjusted to keep the block layout valid
+void bfl_params_use(const bfl_params_t* p);
+#endif
+
+// create a binned free list growing the given memlib region
+binned_free_list bfl_new(int region);
 
 // malloc using binned free list
 void* bfl_malloc(binned_free_list* bfl, size_t size);
 
+// malloc of size bytes aligned to alignment (a power of two), splitting
+// off the leading fragment as a free block
+void* bfl_memalign(binned_free_list* bfl, size_t alignment, size_t size);
+
+// malloc of size zeroed bytes
+void* bfl_calloc(binned_free_list* bfl, size_t size);
+
 // free using binned free list
 void bfl_free(binned_free_list* bfl, void* ptr);
 
+// free of a block malloc'd with size bytes; same as bfl_free, and debug
+// builds check the size
+void bfl_free_sized(binned_free_list* bfl, void* ptr, size_t size);
+
 // realloc using binned free list
 void* bfl_realloc(binned_free_list* bfl, void* ptr, size_t size);
 
+// n mallocs of size bytes, carved contiguously from one free block at a
+// time; returns how many succeeded
+size_t bfl_malloc_batch(binned_free_list* bfl, size_t size, size_t n, void** out);
+
+// free the n blocks of ptrs, sorted in place by address so that adjacent
+// blocks are merged before they reach the bins
+void bfl_free_batch(binned_free_list* bfl, void** ptrs, size_t n);
+
 // log base 2, rounding up: lg2(8)==3; lg2(9)==4.
-static lgsize_t lg2_up(size_t n) {
+static inline lgsize_t lg2_up(size_t n) {
   if (n == 0) return 0;
   lgsize_t ups = (31 - __builtin_clz((int) n));
   return ((1 << ups) != n) ? (ups + 1) : ups;
 }
 
 // log base 2, rounding down: lg2(15)==3; lg2(16)==4;
-static lgsize_t lg2_down(size_t n) {
+static inline lgsize_t lg2_down(size_t n) {
   return (n == 0) ? 0 : (31 - __builtin_clz((int) n));
 }
 
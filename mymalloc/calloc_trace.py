@@ -0,0 +1,37 @@
+#!/usr/bin/env python
+#
+# calloc_trace.py - rewrite a trace with calloc requests.
+#
+# Every malloc becomes a calloc of the same size, as if the program wanted
+# its blocks zeroed:
+#   c {pointer-id} {size}   calloc
+# Running mdriver on the rewritten traces, and mdriver -s built with
+# STATS=1, shows how much of the zeroing the allocator skips on memory
+# fresh from mem_sbrk.
+#
+# Usage: ./calloc_trace.py traces/trace_c4_v0 > calloc_traces/trace_c4_v0
+#
+from __future__ import print_function
+import sys
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s <tracefile>' % sys.argv[0])
+    with open(sys.argv[1]) as f:
+        tokens = f.read().split()
+    out = tokens[:4]
+    i = 4
+    while i < len(tokens):
+        kind = tokens[i]
+        width = {'f': 2, 'F': 3, 'A': 4, 'm': 4}.get(kind, 3)
+        if kind == 'a':
+            out.append('c %s %s' % (tokens[i + 1], tokens[i + 2]))
+        else:
+            out.append(' '.join(tokens[i:i + width]))
+        i += width
+    print('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
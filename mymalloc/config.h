@@ -35,6 +35,20 @@
  */
 #define MAX_HEAP (50*(1<<20))  /* 50 MB */
 
+/*
+ * Growth regions of the heap (see mem_region_sbrk). Region 0 is the heap
+ * of mem_sbrk; each other region gets MEM_REGION_SIZE bytes at the top.
+ * Every build has the same regions, so that engines built with other
+ * options can be loaded into mdriver; only a LIFETIME=1 mdriver gives
+ * region 1 any room, and otherwise region 0 has all of MAX_HEAP.
+ */
+#define MEM_REGIONS 2
+#ifdef BFL_LIFETIME
+#define MEM_REGION_SIZE (MAX_HEAP/8)
+#else
+#define MEM_REGION_SIZE 0
+#endif
+
 #define MEM_ALLOWANCE (40 * (1 << 10)) /* 40 KB */
 
 /*****************************************************************************
@@ -42,6 +56,14 @@
  *****************************************************************************/
 #define USE_FCYC   0   /* cycle counter w/K-best scheme (x86 & Alpha only) */
 #define USE_ITIMER 0   /* interval timer (any Unix box) */
-#define USE_GETTOD 1   /* gettimeofday (any Unix box) */
+#define USE_GETTOD 0   /* gettimeofday (any Unix box) */
+#define USE_CLOCK  1   /* clock_gettime w/warm-up and median (Linux) */
+
+/*
+ * Default warm-up and timed runs per trace for USE_CLOCK. Both can be
+ * overridden at runtime with the -w and -r flags of mdriver.
+ */
+#define FSECS_WARMUP 2
+#define FSECS_REPS   11
 
 #endif  // MM_CONFIG_H
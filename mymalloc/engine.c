@@ -0,0 +1,20 @@
+/*
+ * engine.c - export the student malloc package as an allocator engine.
+ *
+ * make engine ENGINE=name PARAMS="..." builds allocator.c, arena.c and
+ * bfl.c with this file into name.so, which mdriver -a name.so loads next
+ * to the malloc package it was linked with. The engine calls back into
+ * mdriver's memlib, and binds its own my_* symbols with -Bsymbolic, so
+ * that several configurations can be compared in a single run.
+ */
+#include "./allocator_interface.h"
+
+const malloc_impl_t mdriver_engine =
+{ .init = &my_init, .malloc = &my_malloc, .realloc = &my_realloc,
+  .aligned_alloc = &my_aligned_alloc, .calloc = &my_calloc, .free = &my_free,
+  .free_sized = &my_free_sized, .check = &my_check, .reset_brk = &my_reset_brk,
+  .heap_lo = &my_heap_lo, .heap_hi = &my_heap_hi,
+  .stats = &my_stats, .malloc_batch = &my_malloc_batch,
+  .free_batch = &my_free_batch, .arena_create = &my_arena_create,
+  .arena_alloc = &my_arena_alloc, .arena_reset = &my_arena_reset,
+  .arena_destroy = &my_arena_destroy};
@@ -23,7 +23,10 @@
 /****************************
  * High-level timing wrappers
  ****************************/
+#define _GNU_SOURCE
+#include <sched.h>
 #include <stdio.h>
+#include <string.h>
 #include "./fsecs.h"
 #include "./fcyc.h"
 #include "./clock.h"
@@ -32,6 +35,13 @@
 
 static double Mhz;  /* estimated CPU clock frequency */
 
+/* Parameters of the clock_gettime timer (USE_CLOCK) */
+static int warmup_runs = FSECS_WARMUP;
+static int timed_runs = FSECS_REPS;
+static fsecs_test_funct setup_funct = NULL;
+static int pin_cpu = -1;
+static ftimer_stats_t last_stats;
+
 extern int verbose; /* -v option in mdriver.c */
 
 /*
@@ -39,6 +49,18 @@ extern int verbose; /* -v option in mdriver.c */
  */
 void init_fsecs(void) {
   Mhz = 0; /* keep gcc -Wall happy */
+  memset(&last_stats, 0, sizeof(last_stats));
+
+  if (pin_cpu >= 0) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(pin_cpu, &set);
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+      perror("sched_setaffinity");
+    } else if (verbose) {
+      printf("Pinned to CPU %d.\n", pin_cpu);
+    }
+  }
 
 #if USE_FCYC
   if (verbose)
@@ -57,6 +79,11 @@ void init_fsecs(void) {
 #elif USE_GETTOD
   if (verbose)
     printf("Measuring performance with gettimeofday().\n");
+#elif USE_CLOCK
+  if (verbose)
+    printf("Measuring performance with clock_gettime(), "
+           "median of %d runs after %d warm-up runs.\n",
+           timed_runs, warmup_runs);
 #endif
 }
 
@@ -71,5 +98,50 @@ double fsecs(fsecs_test_funct f, void *argp) {
   return ftimer_itimer(f, argp, 10);
 #elif USE_GETTOD
   return ftimer_gettod(f, argp, 10);
+#elif USE_CLOCK
+  return ftimer_clock(f, setup_funct, argp, warmup_runs, timed_runs, &last_stats);
 #endif
 }
+
+/*
+ * fsecs_last_stats - Return the spread of the runs behind the last call to
+ *     fsecs. Only filled in by the clock_gettime timer; n is 0 otherwise.
+ */
+const ftimer_stats_t *fsecs_last_stats(void) {
+  return &last_stats;
+}
+
+/*
+ * set_fsecs_warmup - Number of untimed runs before measuring
+ *     Default = FSECS_WARMUP
+ */
+void set_fsecs_warmup(int n) {
+  warmup_runs = (n < 0) ? 0 : n;
+}
+
+/*
+ * set_fsecs_reps - Number of timed runs per measurement
+ *     Default = FSECS_REPS
+ */
+void set_fsecs_reps(int n) {
+  timed_runs = (n < 1) ? 1 : n;
+}
+
+/*
+ * set_fsecs_setup - Call setup(argp), untimed, before every run of the
+ *     function fsecs measures, or nothing if NULL. Only the clock_gettime
+ *     timer does.
+ *     Default = NULL
+ */
+void set_fsecs_setup(fsecs_test_funct setup) {
+  setup_funct = setup;
+}
+
+/*
+ * set_fsecs_cpu - Pin the process to this CPU in init_fsecs, or -1 to
+ *     leave scheduling alone.
+ *     Default = -1
+ */
+void set_fsecs_cpu(int cpu) {
+  pin_cpu = cpu;
+}
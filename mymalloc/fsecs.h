@@ -23,9 +23,17 @@
 #ifndef MM_FSECS_H
 #define MM_FSECS_H
 
+#include "./ftimer.h"
+
 typedef void (*fsecs_test_funct)(void *);
 
 void init_fsecs(void);
 double fsecs(fsecs_test_funct f, void *argp);
+const ftimer_stats_t *fsecs_last_stats(void);
+
+void set_fsecs_warmup(int n);
+void set_fsecs_reps(int n);
+void set_fsecs_cpu(int cpu);
+void set_fsecs_setup(fsecs_test_funct setup);
 
 #endif  // MM_FSECS_H
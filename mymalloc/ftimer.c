@@ -7,9 +7,15 @@
  * Function timers that estimate the running time (in seconds) of a function f.
  *    ftimer_itimer: version that uses the interval timer
  *    ftimer_gettod: version that uses gettimeofday
+ *    ftimer_clock: version that uses clock_gettime(CLOCK_MONOTONIC_RAW)
+ *                  with warm-up runs and robust statistics
  */
+#include <math.h>
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <sys/time.h>
+#include <time.h>
 #include "./ftimer.h"
 
 /* function prototypes */
@@ -52,6 +58,97 @@ double ftimer_gettod(ftimer_test_funct f, void *argp, int n) {
   return (1E-3*diff);
 }
 
+/*
+ * cmp_double - qsort comparator for an array of doubles
+ */
+static int cmp_double(const void *a, const void *b) {
+  double x = *(const double *) a;
+  double y = *(const double *) b;
+  return (x > y) - (x < y);
+}
+
+/*
+ * median_sorted - median of a sorted array of n doubles
+ */
+static double median_sorted(const double *v, int n) {
+  return (n % 2) ? v[n/2] : 0.5 * (v[n/2 - 1] + v[n/2]);
+}
+
+/*
+ * ftimer_clock - Use clock_gettime(CLOCK_MONOTONIC_RAW) to estimate the
+ * running time of f(argp). The first warmup runs are discarded, then n
+ * runs are timed individually. Return the median of the n runs, and fill
+ * in *stats (if not NULL) with the median absolute deviation, the number
+ * of outliers and a distribution-free 95% confidence interval for the
+ * median.
+ */
+double ftimer_clock(ftimer_test_funct f, ftimer_test_funct setup, void *argp,
+                    int warmup, int n, ftimer_stats_t *stats) {
+  struct timespec stv, etv;
+  double *samples, *devs;
+  double med, mad;
+  int i, lo, hi, outliers;
+
+  if (n < 1) {
+    n = 1;
+  }
+  samples = (double *) malloc(n * sizeof(double));
+  devs = (double *) malloc(n * sizeof(double));
+  if (samples == NULL || devs == NULL) {
+    fprintf(stderr, "Fatal error.  Malloc returned null in ftimer_clock\n");
+    exit(1);
+  }
+
+  for (i = 0; i < warmup; i++) {
+    if (setup != NULL) setup(argp);
+    f(argp);
+  }
+  for (i = 0; i < n; i++) {
+    if (setup != NULL) setup(argp);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &stv);
+    f(argp);
+    clock_gettime(CLOCK_MONOTONIC_RAW, &etv);
+    samples[i] = (etv.tv_sec - stv.tv_sec) + 1E-9*(etv.tv_nsec - stv.tv_nsec);
+  }
+
+  qsort(samples, n, sizeof(double), cmp_double);
+  med = median_sorted(samples, n);
+  for (i = 0; i < n; i++) {
+    devs[i] = fabs(samples[i] - med);
+  }
+  qsort(devs, n, sizeof(double), cmp_double);
+  mad = median_sorted(devs, n);
+
+  if (stats != NULL) {
+    /* A run is an outlier if it is more than 3 scaled MADs from the median */
+    outliers = 0;
+    for (i = 0; i < n; i++) {
+      if (fabs(samples[i] - med) > 3 * 1.4826 * mad) {
+        outliers++;
+      }
+    }
+
+    /* Order-statistic ranks bracketing the median with ~95% coverage */
+    lo = (int) floor(0.5 * n - 0.98 * sqrt(n));
+    hi = (int) ceil(0.5 * n + 0.98 * sqrt(n));
+    lo = (lo < 0) ? 0 : lo;
+    hi = (hi > n - 1) ? n - 1 : hi;
+
+    stats->median = med;
+    stats->mad = mad;
+    stats->ci_lo = samples[lo];
+    stats->ci_hi = samples[hi];
+    stats->min = samples[0];
+    stats->max = samples[n-1];
+    stats->n = n;
+    stats->outliers = outliers;
+  }
+
+  free(samples);
+  free(devs);
+  return med;
+}
+
 
 /*
  * Routines for manipulating the Unix interval timer
@@ -8,6 +8,18 @@
  */
 typedef void (*ftimer_test_funct)(void *);
 
+/* Summary of the individual runs measured by ftimer_clock (in seconds) */
+typedef struct {
+  double median;   /* median run time */
+  double mad;      /* median absolute deviation from the median */
+  double ci_lo;    /* lower end of the 95% confidence interval of the median */
+  double ci_hi;    /* upper end of the 95% confidence interval of the median */
+  double min;      /* fastest run */
+  double max;      /* slowest run */
+  int n;           /* number of timed runs */
+  int outliers;    /* runs more than 3 scaled MADs away from the median */
+} ftimer_stats_t;
+
 /* Estimate the running time of f(argp) using the Unix interval timer.
    Return the average of n runs */
 double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
@@ -16,4 +28,11 @@ double ftimer_itimer(ftimer_test_funct f, void *argp, int n);
    Return the average of n runs */
 double ftimer_gettod(ftimer_test_funct f, void *argp, int n);
 
+/* Estimate the running time of f(argp) using clock_gettime(CLOCK_MONOTONIC_RAW)
+   after warmup untimed runs. Return the median of n runs and describe their
+   spread in *stats (may be NULL). If setup isn't NULL, setup(argp) runs
+   untimed before every run of f */
+double ftimer_clock(ftimer_test_funct f, ftimer_test_funct setup, void *argp,
+                    int warmup, int n, ftimer_stats_t *stats);
+
 #endif  // MM_FTIMER_H
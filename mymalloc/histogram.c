@@ -0,0 +1,57 @@
+/*
+ * histogram.c - log-bucketed latency histograms (see histogram.h)
+ */
+#include <string.h>
+
+#include "./histogram.h"
+
+/* Largest value that falls into bucket i */
+static uint64_t lat_bucket_high(int i) {
+  if (i < LAT_SUB_COUNT) return (uint64_t) i;
+  int shift = (i >> LAT_SUB_BITS) - 1;
+  uint64_t mant = (uint64_t) ((i & (LAT_SUB_COUNT - 1)) + LAT_SUB_COUNT);
+  return ((mant + 1) << shift) - 1;
+}
+
+void lat_hist_reset(lat_hist_t *h) {
+  memset(h, 0, sizeof(*h));
+}
+
+uint64_t lat_hist_percentile(const lat_hist_t *h, double p) {
+  if (h->total == 0) return 0;
+  uint64_t rank = (uint64_t) (p * h->total + 0.5);
+  if (rank < 1) rank = 1;
+  uint64_t seen = 0;
+  for (int i = 0; i < LAT_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank) {
+      uint64_t high = lat_bucket_high(i);
+      return (high < h->max) ? high : h->max;
+    }
+  }
+  return h->max;
+}
+
+void lat_hist_print(const lat_hist_t *h, const char *name) {
+  printf("%10s%10lu%10.0f%10lu%10lu%10lu%10lu\n",
+         name,
+         (unsigned long) h->total,
+         h->total ? (double) h->sum / h->total : 0.0,
+         (unsigned long) lat_hist_percentile(h, 0.50),
+         (unsigned long) lat_hist_percentile(h, 0.99),
+         (unsigned long) lat_hist_percentile(h, 0.999),
+         (unsigned long) h->max);
+}
+
+void lat_hist_print_csv(FILE *f, const lat_hist_t *h, const char *trace,
+                        const char *name) {
+  fprintf(f, "%s,%s,%lu,%.1f,%lu,%lu,%lu,%lu\n",
+          trace,
+          name,
+          (unsigned long) h->total,
+          h->total ? (double) h->sum / h->total : 0.0,
+          (unsigned long) lat_hist_percentile(h, 0.50),
+          (unsigned long) lat_hist_percentile(h, 0.99),
+          (unsigned long) lat_hist_percentile(h, 0.999),
+          (unsigned long) h->max);
+}
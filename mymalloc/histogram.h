@@ -0,0 +1,56 @@
+/*
+ * histogram.h - log-bucketed latency histograms, in the style of HDR
+ *     histograms: every power of two is split into 2^LAT_SUB_BITS linear
+ *     sub-buckets, so any recorded value is reported with a relative
+ *     error below 2^-LAT_SUB_BITS while the histogram stays a fixed,
+ *     small array.
+ */
+
+#ifndef MM_HISTOGRAM_H
+#define MM_HISTOGRAM_H
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define LAT_SUB_BITS 4
+#define LAT_SUB_COUNT (1 << LAT_SUB_BITS)
+#define LAT_BUCKETS ((64 - LAT_SUB_BITS + 1) << LAT_SUB_BITS)
+
+typedef struct {
+  uint64_t counts[LAT_BUCKETS];
+  uint64_t total;  /* number of recorded values */
+  uint64_t sum;    /* sum of recorded values, for the mean */
+  uint64_t max;    /* exact largest recorded value */
+} lat_hist_t;
+
+/* Read the time stamp counter; cheap enough to bracket a single call */
+static inline uint64_t lat_now(void) {
+  return __builtin_ia32_rdtsc();
+}
+
+/* Bucket holding value v */
+static inline int lat_bucket(uint64_t v) {
+  if (v < LAT_SUB_COUNT) return (int) v;
+  int shift = (63 - __builtin_clzll(v)) - LAT_SUB_BITS;
+  return ((shift + 1) << LAT_SUB_BITS) + (int) ((v >> shift) - LAT_SUB_COUNT);
+}
+
+static inline void lat_hist_record(lat_hist_t *h, uint64_t v) {
+  h->counts[lat_bucket(v)]++;
+  h->total++;
+  h->sum += v;
+  if (v > h->max) h->max = v;
+}
+
+void lat_hist_reset(lat_hist_t *h);
+
+// Smallest bucket upper bound covering fraction p (in [0, 1]) of the values
+uint64_t lat_hist_percentile(const lat_hist_t *h, double p);
+
+// Print "count mean p50 p99 p99.9 max" as a table row, or as a CSV row
+// prefixed by the trace and op names.
+void lat_hist_print(const lat_hist_t *h, const char *name);
+void lat_hist_print_csv(FILE *f, const lat_hist_t *h, const char *trace,
+                        const char *name);
+
+#endif  // MM_HISTOGRAM_H
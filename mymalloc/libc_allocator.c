@@ -47,6 +47,11 @@ void * libc_heap_hi() {
   return NULL;
 }
 
+/* Libc doesn't expose its internals. */
+const malloc_stats_t * libc_stats() {
+  return NULL;
+}
+
 /*call default malloc */
 void * libc_malloc(size_t size) {
   return malloc(size);
@@ -57,7 +62,42 @@ void * libc_realloc(void *ptr, size_t size) {
   return realloc(ptr, size);
 }
 
+/* posix_memalign, which wants at least pointer alignment */
+void * libc_aligned_alloc(size_t alignment, size_t size) {
+  void *p;
+  if (alignment < sizeof(void *)) return malloc(size);
+  return (posix_memalign(&p, alignment, size) == 0) ? p : NULL;
+}
+
+/*call default calloc */
+void * libc_calloc(size_t nmemb, size_t size) {
+  return calloc(nmemb, size);
+}
+
 /*call default realloc */
 void libc_free(void *ptr) {
   free(ptr);
 }
+
+/* This libc has no free_sized: the size is dropped */
+void libc_free_sized(void *ptr, size_t size) {
+  free(ptr);
+}
+
+/* Libc has no batch calls: one malloc per block */
+size_t libc_malloc_batch(size_t size, size_t n, void **out) {
+  size_t i;
+  for (i = 0; i < n; i++) {
+    if ((out[i] = malloc(size)) == NULL) {
+      break;
+    }
+  }
+  return i;
+}
+
+/* One free per block */
+void libc_free_batch(void **ptrs, size_t n) {
+  for (size_t i = 0; i < n; i++) {
+    free(ptrs[i]);
+  }
+}
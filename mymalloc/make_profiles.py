@@ -0,0 +1,90 @@
+#!/usr/bin/env python
+#
+# make_profiles.py - generate profiles.h, the workload profiles that
+# allocator.c picks from when built with ADAPTIVE=1.
+#
+# Each trace of the given directory gets a profile: the fingerprint of its
+# first FP_WINDOW malloc/realloc requests, computed like allocator.c's
+# fingerprint_note, and the BFL_MIN_BLOCK_SIZE/BFL_MIN_SPLIT_SIZE pair of
+# GRID with the best perfidx on it. The profiles are meant to be tuned on
+# additional_traces/ and used on other variants of the same classes, like
+# the graded ones in traces/; tuning them on traces/ would fit them to the
+# very traces they are scored on.
+#
+# Only the parameters bfl_params_t holds are tuned. BFL_GROW_MAX,
+# BFL_VICTIM_MAX, BFL_HOT_SLOTS, BFL_FIT_ADAPTIVE and BFL_ALIGN_SCAN size
+# structures or compile code paths in or out, so they cannot change after
+# the fingerprint is taken.
+#
+# Needs ./mdriver built with TUNABLE=1 (make profiles does both).
+# Usage: ./make_profiles.py additional_traces > profiles.h
+#
+from __future__ import print_function
+import os
+import re
+import subprocess
+import sys
+
+FP_WINDOW = 1024
+FP_LIMITS = (64, 512, 4096)  # size classes: <= 64, <= 512, <= 4096, larger
+GRID = [(block, split) for block in (32, 64, 128, 256)
+        for split in (64, 128, 256, 512) if split >= block]
+RUNS = '3'
+
+
+def fingerprint(path):
+    """Size mix and realloc ratio of the first FP_WINDOW requests"""
+    with open(path) as f:
+        tokens = f.read().split()
+    sizes = [0] * (len(FP_LIMITS) + 1)
+    reallocs = 0
+    requests = 0
+    i = 4
+    while i < len(tokens) and requests < FP_WINDOW:
+        kind = tokens[i]
+        width = {'f': 2, 'F': 3, 'A': 4, 'm': 4}.get(kind, 3)
+        count, size = 0, 0
+        if kind in ('a', 'c', 'r'):
+            count, size = 1, int(tokens[i + 2])
+        elif kind == 'm':
+            count, size = 1, int(tokens[i + 3])
+        elif kind == 'A':
+            count, size = int(tokens[i + 2]), int(tokens[i + 3])
+        for _ in range(min(count, FP_WINDOW - requests)):
+            sizes[sum(size > limit for limit in FP_LIMITS)] += 1
+            reallocs += (kind == 'r')
+            requests += 1
+        i += width
+    return [float(n) / FP_WINDOW for n in sizes], float(reallocs) / FP_WINDOW
+
+
+def perfidx(path, block, split):
+    env = dict(os.environ, BFL_MIN_BLOCK_SIZE=str(block),
+               BFL_MIN_SPLIT_SIZE=str(split))
+    out = subprocess.check_output(['./mdriver', '-g', '-r', RUNS, '-f', path],
+                                  env=env, universal_newlines=True)
+    return float(re.search(r'^perfidx:(\S+)', out, re.M).group(1))
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s <tracedir>' % sys.argv[0])
+    tracedir = sys.argv[1]
+    print('// Generated by make_profiles.py from %s. Do not edit.' % tracedir)
+    print('// name, size mix, realloc ratio, {min block, min split}  // perfidx')
+    print('static const workload_profile profiles[] = {')
+    for name in sorted(os.listdir(tracedir)):
+        path = os.path.join(tracedir, name)
+        mix, realloc_ratio = fingerprint(path)
+        scores = [(perfidx(path, block, split), -block, -split)
+                  for block, split in GRID]
+        best, block, split = max(scores)
+        cls = re.sub(r'^trace_(c\d+).*', r'\1', name)
+        print('  {"%s", {%s}, %.2f, {%d, %d}},  // %.2f' %
+              (cls, ', '.join('%.2f' % m for m in mix), realloc_ratio,
+               -block, -split, best))
+    print('};')
+
+
+if __name__ == '__main__':
+    main()
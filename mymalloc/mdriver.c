@@ -10,16 +10,44 @@
  * May not be used, modified, or copied without permission.
  */
 
+#include <dlfcn.h>
+
 #include "./mdriver.h"
+#include "./histogram.h"
+#include "./perfctr.h"
 #include "./validator.h"
 
 #ifdef GET_RUNNINGTIME
 #include "./fasttime.h"
 #endif
+
+#ifdef COMPILED_TRACE
+/* Straight-line replay of one trace, generated by trace2c.py */
+extern const char *compiled_trace_file;
+extern const int compiled_trace_ops;
+void compiled_trace_run(void *unused);
+#endif
 /******************************
  * Private compound data types
  *****************************/
 
+/* Access speed of the live blocks at a trace's peak (-o) */
+typedef struct {
+  int blocks;           /* live blocks chained together */
+  double stride;        /* mean |address gap| between blocks in allocation order */
+  double alloc_cycles;  /* cycles per hop, chasing blocks in allocation order */
+  double id_cycles;     /* cycles per hop, chasing blocks in id order */
+} locality_t;
+
+/* Arenas vs. malloc/free on one trace (-A) */
+typedef struct {
+  int allocs;         /* mallocs of the trace replayed */
+  double free_secs;   /* malloc each block, free each at the end of a round */
+  double arena_secs;  /* arena_alloc each block, arena_reset the round */
+  size_t free_heap;   /* heap size after the malloc/free replay */
+  size_t arena_heap;  /* heap size after the arena replay */
+} arena_bench_t;
+
 /* Summarizes the important stats for some malloc function on some trace */
 typedef struct {
   /* defined for both libc malloc and student malloc package (mm.c) */
@@ -27,6 +55,23 @@ typedef struct {
   int valid;       /* was the trace processed correctly by the allocator? */
   int checked;     /* was the heap valid after every allocation? */
   double secs;     /* number of secs needed to run the trace */
+  double alloc_ops;  /* number of malloc/free/realloc ops in the trace */
+  double alloc_secs; /* secs needed to run the trace without writes (-S) */
+
+  /* spread of the timed runs (only with the clock_gettime timer) */
+  ftimer_stats_t timing;
+
+  /* hardware counters of one extra run of the trace (-P) */
+  perfctr_values_t counters;
+
+  /* how fast the application can walk the live blocks (-o) */
+  locality_t locality;
+
+  /* what releasing blocks together saves (-A) */
+  arena_bench_t arena;
+
+  /* secs to run the trace freeing with free_sized, 0 if invalid (-z) */
+  double sized_secs;
 
   /* defined only for the student malloc package */
   double util;     /* space utilization for this trace (always 0 for libc) */
@@ -46,6 +91,29 @@ static char tracedir[MAXLINE] = TRACEDIR;
 
 static const char xor_constant = 0x7B;
 
+/* Allocator engines loaded from shared objects (-a) */
+#define MAX_ENGINES 16
+
+typedef struct {
+  char *path;                  /* shared object it was loaded from */
+  void *handle;                /* dlopen handle */
+  const malloc_impl_t *impl;   /* its ENGINE_SYMBOL descriptor */
+  stats_t *stats;              /* one per trace file */
+} engine_t;
+
+static const malloc_impl_t *engine_impl; /* engine being timed */
+
+/* Arena benchmark (-A): the mallocs of a trace, in rounds of ARENA_ROUND
+   blocks that are all released at the end of the round, like the objects
+   of one request */
+#define ARENA_ROUND 256
+
+static const malloc_impl_t *arena_impl; /* package being timed */
+
+/* Utilization timeline (-u): a CSV row every timeline_interval ops */
+static FILE *timeline = NULL;
+static int timeline_interval = 1000;
+
 /*********************
  * Function prototypes
  *********************/
@@ -56,18 +124,68 @@ static void free_trace(trace_t *trace);
 
 /* Routines for evaluating correctnes, space utilization, and speed
    of the student's malloc package in mm.c */
-static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracenum);
-static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace);
+static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracenum,
+                           const char *tracefile);
+static void sample_timeline(const malloc_impl_t *impl, const char *tracefile,
+                            int opnum, int total_size);
+static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace, int writes);
 static void eval_my_speed(trace_t *trace) {
-  eval_mm_speed(&my_impl, trace);
+  eval_mm_speed(&my_impl, trace, 1);
 }
 static void eval_libc_speed(trace_t *trace) {
-  eval_mm_speed(&libc_impl, trace);
+  eval_mm_speed(&libc_impl, trace, 1);
+}
+static void eval_my_alloc_speed(trace_t *trace) {
+  eval_mm_speed(&my_impl, trace, 0);
+}
+static void eval_libc_alloc_speed(trace_t *trace) {
+  eval_mm_speed(&libc_impl, trace, 0);
+}
+static void eval_engine_speed(trace_t *trace) {
+  eval_mm_speed(engine_impl, trace, 1);
+}
+/* Before each timed run of a trace with callocs: start from memory that
+   reads as zero, as a new process would, not from what the last run wrote */
+static void clean_heap(trace_t *trace) {
+  mem_reset_brk();
+  mem_clean();
 }
 static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum);
+static void eval_mm_latency(const malloc_impl_t *impl, trace_t *trace,
+                            lat_hist_t *hists);
+static void report_latency(const malloc_impl_t *impl, trace_t *trace,
+                           const char *pkg, const char *tracefile, FILE *csv);
+static void count_events(void (*f)(trace_t *), trace_t *trace, stats_t *stats);
+static void eval_mm_locality(const malloc_impl_t *impl, trace_t *trace,
+                             locality_t *loc);
+static void eval_rounds(const malloc_impl_t *impl, trace_t *trace, int arena);
+static void eval_rounds_free(trace_t *trace) {
+  eval_rounds(arena_impl, trace, 0);
+}
+static void eval_rounds_arena(trace_t *trace) {
+  eval_rounds(arena_impl, trace, 1);
+}
+static int eval_arena_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum);
+static void eval_mm_arena(const malloc_impl_t *impl, trace_t *trace, int tracenum,
+                          arena_bench_t *bench);
+static double eval_my_sized(trace_t *trace, int tracenum);
 
 /* Various helper routines */
+static void eval_compiled(void);
+static void load_engine(engine_t *engine, char *path);
+static void eval_engine(engine_t *engine, int n, char **tracefiles, char *tracedir);
+static double throughput_ratio(const stats_t *stats, const stats_t *libc_stats);
+static void printengines(int n, char **tracefiles, stats_t *mm_stats,
+                         stats_t *libc_stats, engine_t *engines, int num_engines);
 static void printresults(int n, char **tracefiles, stats_t *stats);
+static void printtiming(int n, char **tracefiles, stats_t *stats);
+static void printcounters(int n, char **tracefiles, stats_t *stats);
+static void printsplit(int n, char **tracefiles, stats_t *stats);
+static void printlocality(int n, char **tracefiles, stats_t *stats);
+static void printarena(int n, char **tracefiles, stats_t *stats);
+static void printsized(int n, char **tracefiles, stats_t *stats);
+static int count_alloc_ops(trace_t *trace);
+static void printallocstats(const char *tracefile, const malloc_stats_t *st);
 static void usage(void);
 
 /**************
@@ -89,6 +207,17 @@ int main(int argc, char **argv) {
   int run_bad = 0;     /* If set, run bad malloc (set by -b) */
   int check_heap = 0;  /* If set, run the student heap checker (set by -c) */
   int autograder = 0;  /* If set, emit summary info for autograder (-g) */
+  int latency = 0;     /* If set, replay each trace with per-op timing (-l) */
+  FILE *latency_csv = NULL; /* Per-op latency percentiles go here (-L) */
+  int counters = 0;    /* If set, read hardware counters per trace (-P) */
+  int alloc_stats = 0; /* If set, print the allocator's statistics (-s) */
+  int split_writes = 0; /* If set, also time each trace without writes (-S) */
+  int locality = 0;    /* If set, measure access speed of the live blocks (-o) */
+  int compiled = 0;    /* If set, compare with the compiled trace (-C) */
+  int arenas = 0;      /* If set, compare arenas with malloc/free (-A) */
+  int sized = 0;       /* If set, check and time free_sized too (-z) */
+  engine_t engines[MAX_ENGINES]; /* Allocator engines to compare (-a) */
+  int num_engines = 0;
 
   /* temporaries used to compute the performance index */
   double total_throughput, total_util, average_util, average_throughput, p1, p2, perfindex;
@@ -97,7 +226,7 @@ int main(int argc, char **argv) {
   /*
    * Read and interpret the command line arguments
    */
-  while ((c = getopt(argc, argv, "f:t:hvVgcb")) != EOF) {
+  while ((c = getopt(argc, argv, "f:t:w:r:p:L:u:n:a:hvVgcblPsSoCAz")) != EOF) {
     switch (c) {
       case 'g': /* Generate summary info for the autograder */
         autograder = 1;
@@ -117,6 +246,67 @@ int main(int argc, char **argv) {
         if (tracedir[strlen(tracedir)-1] != '/')
           strcat(tracedir, "/"); /* path always ends with "/" */
         break;
+      case 'w': /* Untimed warm-up runs per trace */
+        set_fsecs_warmup(atoi(optarg));
+        break;
+      case 'r': /* Timed runs per trace */
+        set_fsecs_reps(atoi(optarg));
+        break;
+      case 'p': /* Pin to one CPU while timing */
+        set_fsecs_cpu(atoi(optarg));
+        break;
+      case 'l': /* Per-op latency percentiles */
+        latency = 1;
+        break;
+      case 'L': /* Per-op latency percentiles, also as CSV */
+        latency = 1;
+        if ((latency_csv = fopen(optarg, "w")) == NULL) {
+          sprintf(msg, "Could not open %s for writing", optarg);
+          unix_error(msg);
+        }
+        fprintf(latency_csv, "package,trace,op,count,mean,p50,p99,p999,max\n");
+        break;
+      case 'P': /* Hardware performance counters */
+        counters = 1;
+        break;
+      case 'u': /* Utilization timeline */
+        if ((timeline = fopen(optarg, "w")) == NULL) {
+          sprintf(msg, "Could not open %s for writing", optarg);
+          unix_error(msg);
+        }
+        fprintf(timeline, "trace,op,live_bytes,heap_bytes,free_bytes,"
+                "largest_free,free_blocks\n");
+        break;
+      case 'n': /* Ops between utilization timeline samples */
+        timeline_interval = atoi(optarg);
+        if (timeline_interval < 1) {
+          timeline_interval = 1;
+        }
+        break;
+      case 'a': /* Load an allocator engine */
+        if (num_engines == MAX_ENGINES) {
+          app_error("Too many -a engines");
+        }
+        load_engine(&engines[num_engines++], optarg);
+        break;
+      case 'C': /* Interpreted vs. compiled replay */
+        compiled = 1;
+        break;
+      case 'A': /* Arenas vs. malloc/free */
+        arenas = 1;
+        break;
+      case 'z': /* free_sized vs. free */
+        sized = 1;
+        break;
+      case 'o': /* Locality of the allocator's placement */
+        locality = 1;
+        break;
+      case 'S': /* Split allocator time from write time */
+        split_writes = 1;
+        break;
+      case 's': /* Allocator statistics */
+        alloc_stats = 1;
+        break;
       case 'b': /* Run bad malloc to check the verifier. */
         run_bad = 1;
         break;
@@ -138,6 +328,13 @@ int main(int argc, char **argv) {
     }
   }
 
+  /* The compiled trace replaces the trace files */
+  if (compiled) {
+    init_fsecs();
+    eval_compiled();
+    exit(0);
+  }
+
   /*
    * If no -f command line arg, then use the entire set of tracefiles
    * defined in default_traces[]
@@ -176,6 +373,12 @@ int main(int argc, char **argv) {
   /* Initialize the timing package */
   init_fsecs();
 
+  /* Open the hardware counters, or carry on without them */
+  if (counters && perfctr_init() == 0) {
+    printf("Hardware performance counters unavailable: %s\n", strerror(errno));
+    counters = 0;
+  }
+
   /*
    * Always run and evaluate the libc malloc package
    */
@@ -191,7 +394,7 @@ int main(int argc, char **argv) {
   /* Evaluate the libc malloc package using the K-best scheme */
   for (i = 0; i < num_tracefiles; i++) {
     trace = read_trace(tracedir, tracefiles[i]);
-    libc_stats[i].ops = trace->num_ops;
+    libc_stats[i].ops = trace->num_requests;
     if (verbose > 1)
       printf("Checking libc malloc for correctness, ");
     libc_stats[i].valid = 1;
@@ -202,6 +405,21 @@ int main(int argc, char **argv) {
       if (verbose > 1)
         printf("and performance.\n");
       libc_stats[i].secs = fsecs((void (*)(void *))eval_libc_speed, trace);
+      libc_stats[i].timing = *fsecs_last_stats();
+      if (split_writes) {
+        libc_stats[i].alloc_ops = count_alloc_ops(trace);
+        libc_stats[i].alloc_secs = (libc_stats[i].alloc_ops == trace->num_requests) ?
+            libc_stats[i].secs : fsecs((void (*)(void *))eval_libc_alloc_speed, trace);
+      }
+      if (counters) {
+        count_events(eval_libc_speed, trace, &libc_stats[i]);
+      }
+      if (locality) {
+        eval_mm_locality(&libc_impl, trace, &libc_stats[i].locality);
+      }
+      if (latency) {
+        report_latency(&libc_impl, trace, "libc", tracefiles[i], latency_csv);
+      }
     }
     free_trace(trace);
   }
@@ -210,6 +428,19 @@ int main(int argc, char **argv) {
   if (verbose) {
     printf("\nResults for libc malloc:\n");
     printresults(num_tracefiles, tracefiles, libc_stats);
+    printtiming(num_tracefiles, tracefiles, libc_stats);
+  }
+  if (split_writes) {
+    printf("\nAllocator vs. write time for libc malloc:\n");
+    printsplit(num_tracefiles, tracefiles, libc_stats);
+  }
+  if (locality) {
+    printf("\nLocality of libc malloc's placement:\n");
+    printlocality(num_tracefiles, tracefiles, libc_stats);
+  }
+  if (counters) {
+    printf("\nHardware counters per op for libc malloc:\n");
+    printcounters(num_tracefiles, tracefiles, libc_stats);
   }
 
   /* Initialize the simulated memory system in memlib.c */
@@ -232,7 +463,7 @@ int main(int argc, char **argv) {
     /* Evaluate the bad malloc package using the K-best scheme */
     for (i = 0; i < num_tracefiles; i++) {
       trace = read_trace(tracedir, tracefiles[i]);
-      bad_stats[i].ops = trace->num_ops;
+      bad_stats[i].ops = trace->num_requests;
       printf("Checking bad malloc for correctness.\n");
       bad_stats[i].valid = eval_mm_valid(&bad_impl, trace, i);
       if (check_heap) {
@@ -264,7 +495,7 @@ int main(int argc, char **argv) {
   /* Evaluate student's mm malloc package using the K-best scheme */
   for (i = 0; i < num_tracefiles; i++) {
     trace = read_trace(tracedir, tracefiles[i]);
-    mm_stats[i].ops = trace->num_ops;
+    mm_stats[i].ops = trace->num_requests;
     if (verbose > 1) {
       printf("Checking mm_malloc for correctness, ");
     }
@@ -276,15 +507,48 @@ int main(int argc, char **argv) {
       if (verbose > 1) {
         printf("efficiency, ");
       }
-      mm_stats[i].util = eval_mm_util(&my_impl, trace, i);
+      mm_stats[i].util = eval_mm_util(&my_impl, trace, i, tracefiles[i]);
+      if (alloc_stats) {
+        printallocstats(tracefiles[i], my_impl.stats());
+      }
       if (verbose > 1) {
         printf("and performance.\n");
       }
+      if (trace->num_callocs > 0) {
+        set_fsecs_setup((void (*)(void *))clean_heap);
+      }
       mm_stats[i].secs = fsecs((void (*)(void *))eval_my_speed, trace);
+      mm_stats[i].timing = *fsecs_last_stats();
+      if (split_writes) {
+        mm_stats[i].alloc_ops = count_alloc_ops(trace);
+        mm_stats[i].alloc_secs = (mm_stats[i].alloc_ops == trace->num_requests) ?
+            mm_stats[i].secs : fsecs((void (*)(void *))eval_my_alloc_speed, trace);
+      }
+      set_fsecs_setup(NULL);
+      if (counters) {
+        count_events(eval_my_speed, trace, &mm_stats[i]);
+      }
+      if (locality) {
+        eval_mm_locality(&my_impl, trace, &mm_stats[i].locality);
+      }
+      if (arenas && my_impl.arena_create != NULL) {
+        eval_mm_arena(&my_impl, trace, i, &mm_stats[i].arena);
+      }
+      if (sized) {
+        mm_stats[i].sized_secs = eval_my_sized(trace, i);
+      }
+      if (latency) {
+        report_latency(&my_impl, trace, "mm", tracefiles[i], latency_csv);
+      }
     }
     free_trace(trace);
   }
 
+  /* Evaluate each engine the same way, without the optional extras */
+  for (i = 0; i < num_engines; i++) {
+    eval_engine(&engines[i], num_tracefiles, tracefiles, tracedir);
+  }
+
   /* Free the simulated heap block. */
   mem_deinit();
 
@@ -292,8 +556,36 @@ int main(int argc, char **argv) {
   if (verbose) {
     printf("\nResults for mm malloc:\n");
     printresults(num_tracefiles, tracefiles, mm_stats);
+    printtiming(num_tracefiles, tracefiles, mm_stats);
+    printf("\n");
+  }
+  if (split_writes) {
+    printf("Allocator vs. write time for mm malloc:\n");
+    printsplit(num_tracefiles, tracefiles, mm_stats);
+    printf("\n");
+  }
+  if (locality) {
+    printf("Locality of mm malloc's placement:\n");
+    printlocality(num_tracefiles, tracefiles, mm_stats);
+    printf("\n");
+  }
+  if (arenas) {
+    printf("Arenas vs. malloc/free for mm malloc (%d mallocs per release):\n",
+           ARENA_ROUND);
+    printarena(num_tracefiles, tracefiles, mm_stats);
     printf("\n");
   }
+  if (sized) {
+    printf("free_sized vs. free for mm malloc:\n");
+    printsized(num_tracefiles, tracefiles, mm_stats);
+    printf("\n");
+  }
+  if (counters) {
+    printf("Hardware counters per op for mm malloc:\n");
+    printcounters(num_tracefiles, tracefiles, mm_stats);
+    printf("\n");
+    perfctr_deinit();
+  }
 
   /*
    * Accumulate the aggregate statistics for the student's mm package
@@ -316,9 +608,7 @@ int main(int argc, char **argv) {
       double base_throughput = LIBC_MULTIPLIER * libc_throughput;
       if (base_throughput > MAX_BASE_THROUGHPUT)
         base_throughput = MAX_BASE_THROUGHPUT;
-      double ratio = my_throughput / base_throughput;
-      if (ratio > 1.0)
-        ratio = 1.0;
+      double ratio = throughput_ratio(&mm_stats[i], &libc_stats[i]);
       total_throughput += ratio;
 
       if (verbose) {
@@ -341,18 +631,47 @@ int main(int argc, char **argv) {
   printf("# %f (util)  +  %f (tput)  =  %f\n", p1, p2, perfindex);
 
   if (autograder) {
+    double total_ops = 0, total_secs = 0;
+    for (i = 0; i < num_tracefiles; i++) {
+      if (mm_stats[i].valid) {
+        total_ops += mm_stats[i].ops;
+        total_secs += mm_stats[i].secs;
+      }
+    }
     printf("correct:%d\n", numcorrect);
+    /* The two objectives separately, for multi-objective tuning: mean
+       utilization and capped throughput ratio in percent, and the raw
+       (uncapped) throughput of the mm package in Kops/sec */
+    printf("util:%f\n", 100.0 * average_util);
+    printf("tput:%f\n", 100.0 * average_throughput);
+    printf("kops:%f\n", total_secs > 0 ? total_ops / total_secs / 1000 : 0);
     printf("perfidx:%f\n", perfindex);
   }
 
+  if (num_engines > 0) {
+    printengines(num_tracefiles, tracefiles, mm_stats, libc_stats,
+                 engines, num_engines);
+  }
+
   if (errors != 0) {
     printf("Terminated with %d errors\n", errors);
   }
 
+  if (latency_csv != NULL) {
+    fclose(latency_csv);
+  }
+  if (timeline != NULL) {
+    fclose(timeline);
+  }
+
   /* Keep valgrind happy, free the arrays. */
   free(libc_stats);
   free(bad_stats);
   free(mm_stats);
+  for (i = 0; i < num_engines; i++) {
+    free(engines[i].stats);
+    dlclose(engines[i].handle);
+  }
 
   for (i = 0; i < num_tracefiles; i++) {
     free(tracefiles[i]);
@@ -379,7 +698,7 @@ static trace_t *read_trace(char *tracedir, char *filename) {
   trace_t *trace;
   char type[MAXLINE];
   char path[MAXLINE];
-  unsigned index, size;
+  unsigned index, size, count;
   unsigned max_index = 0;
   unsigned op_index;
 
@@ -425,6 +744,8 @@ static trace_t *read_trace(char *tracedir, char *filename) {
   /* read every request line in the trace file */
   index = 0;
   op_index = 0;
+  trace->num_requests = 0;
+  trace->num_callocs = 0;
   while (fscanf(tracefile, "%s", type) != EOF) {
     switch (type[0]) {
       case 'a':
@@ -432,6 +753,16 @@ static trace_t *read_trace(char *tracedir, char *filename) {
         trace->ops[op_index].type = ALLOC;
         trace->ops[op_index].index = index;
         trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
+        max_index = (index > max_index) ? index : max_index;
+        break;
+      case 'c':
+        fscanf(tracefile, "%u %u", &index, &size);
+        trace->ops[op_index].type = CALLOC;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
+        trace->num_callocs++;
         max_index = (index > max_index) ? index : max_index;
         break;
       case 'r':
@@ -439,12 +770,24 @@ static trace_t *read_trace(char *tracedir, char *filename) {
         trace->ops[op_index].type = REALLOC;
         trace->ops[op_index].index = index;
         trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
+        max_index = (index > max_index) ? index : max_index;
+        break;
+      case 'm':
+        fscanf(tracefile, "%u %u %u", &index, &count, &size);
+        trace->ops[op_index].type = ALLOC_ALIGNED;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].align = count;
+        trace->ops[op_index].size = size;
+        trace->block_sizes[index] = size;
         max_index = (index > max_index) ? index : max_index;
         break;
       case 'f':
         fscanf(tracefile, "%ud", &index);
         trace->ops[op_index].type = FREE;
         trace->ops[op_index].index = index;
+        /* the size the block has by now, for free_sized */
+        trace->ops[op_index].size = trace->block_sizes[index];
         break;
       case 'w':
         fscanf(tracefile, "%u %u", &index, &size);
@@ -452,11 +795,30 @@ static trace_t *read_trace(char *tracedir, char *filename) {
         trace->ops[op_index].index = index;
         trace->ops[op_index].size = size;
         break;
+      case 'A':
+        fscanf(tracefile, "%u %u %u", &index, &count, &size);
+        trace->ops[op_index].type = ALLOC_BATCH;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].count = count;
+        trace->ops[op_index].size = size;
+        for (unsigned j = 0; j < count; j++) {
+          trace->block_sizes[index + j] = size;
+        }
+        max_index = (index + count - 1 > max_index) ? index + count - 1 : max_index;
+        break;
+      case 'F':
+        fscanf(tracefile, "%u %u", &index, &count);
+        trace->ops[op_index].type = FREE_BATCH;
+        trace->ops[op_index].index = index;
+        trace->ops[op_index].count = count;
+        break;
       default:
         printf("Bogus type character (%c) in tracefile %s\n",
                type[0], path);
         exit(1);
     }
+    trace->num_requests += (type[0] == 'A' || type[0] == 'F') ?
+        trace->ops[op_index].count : 1;
     op_index++;
   }
   fclose(tracefile);
@@ -490,9 +852,12 @@ void free_trace(trace_t *trace) {
  *   size of the heap in bytes after running the student's malloc
  *   package on the trace.
  *
+ *   With -u, also write a sample of the heap to the timeline every
+ *   timeline_interval ops and after the last one.
  */
-static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
-  int i;
+static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracenum,
+                           const char *tracefile) {
+  int i, j, n;
   int index;
   int size, newsize, oldsize;
   int max_total_size = 0;
@@ -501,8 +866,12 @@ static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracen
   char *p;
   char *newp, *oldp;
 
-  /* initialize the heap and the mm malloc package */
+  /* initialize the heap, clean like for the timed runs, and the mm
+     malloc package */
   mem_reset_brk();
+  if (trace->num_callocs > 0) {
+    mem_clean();
+  }
   if (impl->init() < 0) {
     app_error("init failed in eval_mm_util");
   }
@@ -510,10 +879,19 @@ static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracen
   for (i = 0; i < trace->num_ops; i++) {
     switch (trace->ops[i].type) {
       case ALLOC: /* alloc */
+      case ALLOC_ALIGNED: /* aligned_alloc */
+      case CALLOC: /* calloc */
         index = trace->ops[i].index;
         size = trace->ops[i].size;
 
-        if ((p = (char *) impl->malloc(size)) == NULL) {
+        if (trace->ops[i].type == ALLOC) {
+          p = (char *) impl->malloc(size);
+        } else if (trace->ops[i].type == ALLOC_ALIGNED) {
+          p = (char *) impl->aligned_alloc(trace->ops[i].align, size);
+        } else {
+          p = (char *) impl->calloc(1, size);
+        }
+        if (p == NULL) {
           app_error("malloc failed in eval_mm_util");
         }
 
@@ -565,12 +943,42 @@ static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracen
 
         break;
 
+      case ALLOC_BATCH: /* malloc_batch */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        n = trace->ops[i].count;
+
+        if (impl->malloc_batch(size, n, (void **) &trace->blocks[index]) != (size_t) n) {
+          app_error("malloc_batch failed in eval_mm_util");
+        }
+        for (j = 0; j < n; j++) {
+          trace->block_sizes[index + j] = size;
+        }
+        total_size += n * size;
+        max_total_size = (total_size > max_total_size) ?
+            total_size : max_total_size;
+        break;
+
+      case FREE_BATCH: /* free_batch */
+        index = trace->ops[i].index;
+        n = trace->ops[i].count;
+        for (j = 0; j < n; j++) {
+          total_size -= trace->block_sizes[index + j];
+        }
+        impl->free_batch((void **) &trace->blocks[index], n);
+        break;
+
       case WRITE: /* write */
         break;
 
       default:
         app_error("Nonexistent request type in eval_mm_util");
     }
+
+    if (timeline != NULL &&
+        ((i + 1) % timeline_interval == 0 || i == trace->num_ops - 1)) {
+      sample_timeline(impl, tracefile, i + 1, total_size);
+    }
   }
   max_total_size = (max_total_size > MEM_ALLOWANCE) ?
     max_total_size : MEM_ALLOWANCE;
@@ -580,6 +988,25 @@ static double eval_mm_util(const malloc_impl_t *impl, trace_t *trace, int tracen
   return ((double)max_total_size / (double)heap_size);
 }
 
+/*
+ * sample_timeline - write one utilization timeline row: live payload bytes,
+ *    heap size and, if the allocator can report them, its free bytes,
+ *    largest free block and number of free blocks (-1 if it can't).
+ */
+static void sample_timeline(const malloc_impl_t *impl, const char *tracefile,
+                            int opnum, int total_size) {
+  const malloc_stats_t *st = impl->stats();
+
+  fprintf(timeline, "%s,%d,%d,%zu,", tracefile, opnum, total_size,
+          mem_heapsize());
+  if (st != NULL) {
+    fprintf(timeline, "%zu,%zu,%zu\n",
+            st->free_bytes, st->largest_free, st->free_blocks);
+  } else {
+    fprintf(timeline, "-1,-1,-1\n");
+  }
+}
+
 static void mem_op(volatile char *raddr, volatile char *waddr) {
   *waddr = *raddr ^ xor_constant;
 }
@@ -587,8 +1014,11 @@ static void mem_op(volatile char *raddr, volatile char *waddr) {
 /*
  * eval_mm_speed - This is the function that is used by fcyc()
  *    to measure the running time of the mm malloc package.
+ *    If writes is 0, WRITE requests are skipped, which leaves only
+ *    the time spent in the allocator (and the replay loop).
  */
-static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace) {
+static inline void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace,
+                                 int writes) {
   int i, index, size, newsize;
   char *p, *newp, *oldp, *block;
 
@@ -609,6 +1039,21 @@ static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace) {
         trace->blocks[index] = p;
         break;
 
+      case ALLOC_ALIGNED: /* aligned_alloc */
+        index = trace->ops[i].index;
+        p = (char *) impl->aligned_alloc(trace->ops[i].align, trace->ops[i].size);
+        if (p == NULL)
+          app_error("aligned_alloc error in eval_mm_speed");
+        trace->blocks[index] = p;
+        break;
+
+      case CALLOC: /* calloc */
+        index = trace->ops[i].index;
+        if ((p = (char *) impl->calloc(1, trace->ops[i].size)) == NULL)
+          app_error("calloc error in eval_mm_speed");
+        trace->blocks[index] = p;
+        break;
+
       case REALLOC: /* realloc */
         index = trace->ops[i].index;
         newsize = trace->ops[i].size;
@@ -624,7 +1069,28 @@ static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace) {
         impl->free(block);
         break;
 
+      case FREE_SIZED: /* free_sized */
+        index = trace->ops[i].index;
+        block = trace->blocks[index];
+        impl->free_sized(block, trace->ops[i].size);
+        break;
+
+      case ALLOC_BATCH: /* malloc_batch */
+        index = trace->ops[i].index;
+        if (impl->malloc_batch(trace->ops[i].size, trace->ops[i].count,
+                               (void **) &trace->blocks[index]) !=
+            (size_t) trace->ops[i].count)
+          app_error("malloc_batch error in eval_mm_speed");
+        break;
+
+      case FREE_BATCH: /* free_batch */
+        index = trace->ops[i].index;
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        break;
+
       case WRITE: /* write */
+        if (!writes)
+          break;
         index = trace->ops[i].index;
         size = trace->ops[i].size;
         p = trace->blocks[index];
@@ -643,28 +1109,59 @@ static void eval_mm_speed(const malloc_impl_t *impl, trace_t *trace) {
 }
 
 /*
- * eval_mm_check - This function is used to check the heap of the student's
- *    implementation.  Returns 0 on check failure, and 1 on pass.
+ * eval_mm_latency - Replay the trace like eval_mm_speed, but read the
+ *    cycle counter around every malloc, free and realloc call and record
+ *    the elapsed cycles in hists[ALLOC], hists[FREE] and hists[REALLOC].
+ *    Writes are still performed so that the caches see the same traffic,
+ *    but they are not timed.
  */
-static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
+static void eval_mm_latency(const malloc_impl_t *impl, trace_t *trace,
+                            lat_hist_t *hists) {
   int i, index, size, newsize;
   char *p, *newp, *oldp, *block;
+  uint64_t start;
 
-  /* Reset the heap and initialize the mm package */
+  /* Reset the heap, clean like for the timed runs, and initialize the
+     mm package */
   mem_reset_brk();
+  if (trace->num_callocs > 0) {
+    mem_clean();
+  }
   if (impl->init() < 0) {
-    malloc_error(tracenum, 0, "impl init failed.");
+    app_error("init failed in eval_mm_latency");
   }
+
   /* Interpret each trace request */
   for (i = 0; i < trace->num_ops; i++) {
     switch (trace->ops[i].type) {
       case ALLOC: /* malloc */
         index = trace->ops[i].index;
         size = trace->ops[i].size;
-        if ((p = (char *) impl->malloc(size)) == NULL) {
-          malloc_error(tracenum, i, "impl malloc failed.");
-          return 0;
-        }
+        start = lat_now();
+        p = (char *) impl->malloc(size);
+        lat_hist_record(&hists[ALLOC], lat_now() - start);
+        if (p == NULL)
+          app_error("malloc error in eval_mm_latency");
+        trace->blocks[index] = p;
+        break;
+
+      case ALLOC_ALIGNED: /* aligned_alloc */
+        index = trace->ops[i].index;
+        start = lat_now();
+        p = (char *) impl->aligned_alloc(trace->ops[i].align, trace->ops[i].size);
+        lat_hist_record(&hists[ALLOC_ALIGNED], lat_now() - start);
+        if (p == NULL)
+          app_error("aligned_alloc error in eval_mm_latency");
+        trace->blocks[index] = p;
+        break;
+
+      case CALLOC: /* calloc */
+        index = trace->ops[i].index;
+        start = lat_now();
+        p = (char *) impl->calloc(1, trace->ops[i].size);
+        lat_hist_record(&hists[CALLOC], lat_now() - start);
+        if (p == NULL)
+          app_error("calloc error in eval_mm_latency");
         trace->blocks[index] = p;
         break;
 
@@ -672,80 +1169,717 @@ static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum
         index = trace->ops[i].index;
         newsize = trace->ops[i].size;
         oldp = trace->blocks[index];
-        if ((newp = (char *) impl->realloc(oldp, newsize)) == NULL) {
-          malloc_error(tracenum, i, "impl realloc failed.");
-          return 0;
-        }
+        start = lat_now();
+        newp = (char *) impl->realloc(oldp, newsize);
+        lat_hist_record(&hists[REALLOC], lat_now() - start);
+        if (newp == NULL)
+          app_error("realloc error in eval_mm_latency");
         trace->blocks[index] = newp;
         break;
 
       case FREE: /* free */
         index = trace->ops[i].index;
         block = trace->blocks[index];
+        start = lat_now();
         impl->free(block);
+        lat_hist_record(&hists[FREE], lat_now() - start);
+        break;
+
+      case ALLOC_BATCH: /* malloc_batch */
+        index = trace->ops[i].index;
+        start = lat_now();
+        size = impl->malloc_batch(trace->ops[i].size, trace->ops[i].count,
+                                  (void **) &trace->blocks[index]);
+        lat_hist_record(&hists[ALLOC_BATCH], lat_now() - start);
+        if (size != trace->ops[i].count)
+          app_error("malloc_batch error in eval_mm_latency");
+        break;
+
+      case FREE_BATCH: /* free_batch */
+        index = trace->ops[i].index;
+        start = lat_now();
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        lat_hist_record(&hists[FREE_BATCH], lat_now() - start);
         break;
 
       case WRITE: /* write */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        p = trace->blocks[index];
+        if (size > 1) {
+          for (int offset = 1; offset < size; offset++) {
+            mem_op(p + offset - 1, p + offset);
+          }
+        }
         break;
 
       default:
-        app_error("Nonexistent request type in eval_mm_check");
+        app_error("Nonexistent request type in eval_mm_latency");
     }
+  }
+}
 
-    if (impl->check() < 0) {
-      malloc_error(tracenum, i, "impl check failed.");
-      return 0;
+/*
+ * report_latency - Replay the trace once with per-op timing and print the
+ *    latency percentiles (in cycles) of each op type, optionally also as
+ *    CSV rows.
+ */
+static void report_latency(const malloc_impl_t *impl, trace_t *trace,
+                           const char *pkg, const char *tracefile, FILE *csv) {
+  static const char *names[] = {"malloc", "free", "realloc",
+                                 "malloc_batch", "free_batch", "aligned",
+                                 "calloc"};
+  static const traceop_type types[] = {ALLOC, FREE, REALLOC,
+                                       ALLOC_BATCH, FREE_BATCH, ALLOC_ALIGNED,
+                                       CALLOC};
+  lat_hist_t hists[NUM_TRACEOP_TYPES];
+  char label[MAXLINE];
+  int i;
+
+  for (i = 0; i < NUM_TRACEOP_TYPES; i++) {
+    lat_hist_reset(&hists[i]);
+  }
+  eval_mm_latency(impl, trace, hists);
+
+  printf("\nLatency (cycles) of %s malloc on %s:\n", pkg, tracefile);
+  printf("%10s%10s%10s%10s%10s%10s%10s\n",
+         "op", "count", "mean", "p50", "p99", "p99.9", "max");
+  snprintf(label, MAXLINE, "%s,%s", pkg, tracefile);
+  for (i = 0; i < (int) (sizeof(types) / sizeof(types[0])); i++) {
+    const lat_hist_t *h = &hists[types[i]];
+    if (h->total == 0) {
+      continue;
+    }
+    lat_hist_print(h, names[i]);
+    if (csv != NULL) {
+      lat_hist_print_csv(csv, h, label, names[i]);
     }
   }
+}
 
-  return 1;
+/*
+ * count_alloc_ops - number of malloc/free/realloc requests in the trace,
+ *    counting each block of a batch
+ */
+static int count_alloc_ops(trace_t *trace) {
+  int i, n = 0;
+  for (i = 0; i < trace->num_ops; i++) {
+    if (trace->ops[i].type == ALLOC_BATCH || trace->ops[i].type == FREE_BATCH) {
+      n += trace->ops[i].count;
+    } else if (trace->ops[i].type != WRITE) {
+      n++;
+    }
+  }
+  return n;
 }
 
-/*************************************
- * Some miscellaneous helper routines
- ************************************/
+/*
+ * count_events - Run the trace once more under the hardware counters
+ */
+static void count_events(void (*f)(trace_t *), trace_t *trace, stats_t *stats) {
+  perfctr_start();
+  f(trace);
+  perfctr_stop(&stats->counters);
+}
 
+/*
+ * chase - follow the ring of next pointers stored at the start of each
+ *    block for hops hops, rewriting each pointer as it goes, and return
+ *    the average number of cycles per hop.
+ */
+static double chase(char *start, long hops) {
+  char *volatile *p = (char *volatile *) start;
+  uint64_t begin = lat_now();
+  for (long h = 0; h < hops; h++) {
+    char *next = *p;
+    *p = next;
+    p = (char *volatile *) next;
+  }
+  return (double) (lat_now() - begin) / hops;
+}
 
 /*
- * printresults - prints a performance summary for some malloc package
+ * link_ring - store in each block of order[0..m-1] a pointer to the next
+ *    one, and in the last a pointer back to the first
  */
-static void printresults(int n, char **tracefiles, stats_t *stats) {
-  int i;
-  double total_ops = 0, total_secs = 0, total_throughput = 0, total_util = 0;
+static void link_ring(trace_t *trace, const int *order, int m) {
+  for (int j = 0; j < m; j++) {
+    *(char **) trace->blocks[order[j]] = trace->blocks[order[(j + 1) % m]];
+  }
+}
 
-  /* Print the individual results for each trace */
-  printf("%5s%27s%10s%10s%6s%8s%10s%9s\n",
-         "trace", "filename", " valid", "checked", "util", "ops", "secs", "Kops/sec");
-  for (i = 0; i < n; i++) {
-    if (stats[i].valid) {
-      double throughput = (stats[i].ops/stats[i].secs)/1e3;
-      printf("%2d%30s%10s%10s%5.0f%%%8.0f%10.6f %8.0f\n",
-             i,
-             tracefiles[i],
-             "yes",
-             (stats[i].checked ? "yes" : "no"),
-             stats[i].util*100.0,
-             stats[i].ops,
-             stats[i].secs,
-             throughput);
-      total_ops += stats[i].ops;
-      total_secs += stats[i].secs;
-      total_throughput += throughput;
-      total_util += stats[i].util;
-    } else {
-      printf("%2d%30s%10s%10s%6s%8s%10s%8s\n",
-             i,
-             tracefiles[i],
-             "no",
-             (stats[i].checked ? "yes" : "no"),
-             "-",
-             "-",
-             "-",
-             "-");
-    }
+/*
+ * eval_mm_locality - Measure how the allocator's placement affects an
+ *    application walking its objects. The trace is replayed up to the
+ *    point where the most payload bytes are live; the live blocks are then
+ *    linked into a ring, once in the order they were allocated and once in
+ *    id order, and each ring is chased (a read and a write per block).
+ *    Allocators that put consecutive allocations next to each other make
+ *    the allocation-order walk cheap. The rest of the trace is replayed
+ *    afterwards so that every block is released.
+ */
+static void eval_mm_locality(const malloc_impl_t *impl, trace_t *trace,
+                             locality_t *loc) {
+  int i, j, index, m, peak_op = -1;
+  long live = 0, peak_live = -1, hops;
+  long *seq, next_seq = 0;
+  int *sizes, *order;
+  char *p;
+
+  memset(loc, 0, sizeof(*loc));
+  seq = (long *) calloc(trace->num_ids, sizeof(long));
+  sizes = (int *) calloc(trace->num_ids, sizeof(int));
+  order = (int *) malloc(trace->num_ids * sizeof(int));
+  if (seq == NULL || sizes == NULL || order == NULL) {
+    unix_error("calloc failed in eval_mm_locality");
   }
 
-  /* Print the aggregate results for the set of traces */
+  /* Find the request after which the most payload bytes are live */
+  for (i = 0; i < trace->num_ops; i++) {
+    index = trace->ops[i].index;
+    switch (trace->ops[i].type) {
+      case ALLOC:
+      case ALLOC_ALIGNED:
+      case CALLOC:
+      case REALLOC:
+        live += trace->ops[i].size - sizes[index];
+        sizes[index] = trace->ops[i].size;
+        break;
+      case FREE:
+        live -= sizes[index];
+        sizes[index] = 0;
+        break;
+      case ALLOC_BATCH:
+        for (j = 0; j < trace->ops[i].count; j++) {
+          live += trace->ops[i].size;
+          sizes[index + j] = trace->ops[i].size;
+        }
+        break;
+      case FREE_BATCH:
+        for (j = 0; j < trace->ops[i].count; j++) {
+          live -= sizes[index + j];
+          sizes[index + j] = 0;
+        }
+        break;
+      default:
+        break;
+    }
+    if (live > peak_live) {
+      peak_live = live;
+      peak_op = i;
+    }
+  }
+  memset(sizes, 0, trace->num_ids * sizeof(int));
+
+  /* Reset the heap and initialize the mm package */
+  mem_reset_brk();
+  if (impl->init() < 0) {
+    app_error("init failed in eval_mm_locality");
+  }
+
+  for (i = 0; i < trace->num_ops; i++) {
+    index = trace->ops[i].index;
+    switch (trace->ops[i].type) {
+      case ALLOC:
+        if ((p = (char *) impl->malloc(trace->ops[i].size)) == NULL)
+          app_error("malloc error in eval_mm_locality");
+        trace->blocks[index] = p;
+        sizes[index] = trace->ops[i].size;
+        seq[index] = next_seq++;
+        break;
+      case ALLOC_ALIGNED:
+        if ((p = (char *) impl->aligned_alloc(trace->ops[i].align,
+                                              trace->ops[i].size)) == NULL)
+          app_error("aligned_alloc error in eval_mm_locality");
+        trace->blocks[index] = p;
+        sizes[index] = trace->ops[i].size;
+        seq[index] = next_seq++;
+        break;
+      case CALLOC:
+        if ((p = (char *) impl->calloc(1, trace->ops[i].size)) == NULL)
+          app_error("calloc error in eval_mm_locality");
+        trace->blocks[index] = p;
+        sizes[index] = trace->ops[i].size;
+        seq[index] = next_seq++;
+        break;
+      case REALLOC:
+        if ((p = (char *) impl->realloc(trace->blocks[index],
+                                        trace->ops[i].size)) == NULL)
+          app_error("realloc error in eval_mm_locality");
+        trace->blocks[index] = p;
+        sizes[index] = trace->ops[i].size;
+        seq[index] = next_seq++;
+        break;
+      case FREE:
+        impl->free(trace->blocks[index]);
+        sizes[index] = 0;
+        break;
+      case ALLOC_BATCH:
+        if (impl->malloc_batch(trace->ops[i].size, trace->ops[i].count,
+                               (void **) &trace->blocks[index]) !=
+            (size_t) trace->ops[i].count)
+          app_error("malloc_batch error in eval_mm_locality");
+        for (j = 0; j < trace->ops[i].count; j++) {
+          sizes[index + j] = trace->ops[i].size;
+          seq[index + j] = next_seq++;
+        }
+        break;
+      case FREE_BATCH:
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        for (j = 0; j < trace->ops[i].count; j++) {
+          sizes[index + j] = 0;
+        }
+        break;
+      default:
+        break;
+    }
+    if (i != peak_op) {
+      continue;
+    }
+
+    /* Chain the live blocks that can hold a pointer, in id order... */
+    m = 0;
+    for (index = 0; index < trace->num_ids; index++) {
+      if (sizes[index] >= (int) sizeof(char *)) {
+        order[m++] = index;
+      }
+    }
+    if (m < 2) {
+      continue;
+    }
+    hops = (1L << 22) / m * m;
+    if (hops < m) {
+      hops = m;
+    }
+    loc->blocks = m;
+    link_ring(trace, order, m);
+    loc->id_cycles = chase(trace->blocks[order[0]], hops);
+
+    /* ... and in allocation order (insertion sort: seq is nearly sorted) */
+    for (int j = 1; j < m; j++) {
+      int id = order[j], k = j - 1;
+      while (k >= 0 && seq[order[k]] > seq[id]) {
+        order[k + 1] = order[k];
+        k--;
+      }
+      order[k + 1] = id;
+    }
+    double gaps = 0;
+    for (int j = 1; j < m; j++) {
+      gaps += labs(trace->blocks[order[j]] - trace->blocks[order[j - 1]]);
+    }
+    loc->stride = gaps / (m - 1);
+    link_ring(trace, order, m);
+    loc->alloc_cycles = chase(trace->blocks[order[0]], hops);
+  }
+
+  free(seq);
+  free(sizes);
+  free(order);
+}
+
+/*
+ * eval_rounds - Replay the mallocs of the trace (nothing else) in rounds
+ *    of ARENA_ROUND blocks. At the end of each round its blocks are
+ *    released: freed one by one, or, if arena is set, allocated from an
+ *    arena in the first place and released by a single arena_reset.
+ */
+static void eval_rounds(const malloc_impl_t *impl, trace_t *trace, int arena) {
+  static char *round[ARENA_ROUND];
+  arena_t *a = NULL;
+  int i, j, n = 0;
+
+  /* Reset the heap and initialize the mm package */
+  mem_reset_brk();
+  if (impl->init() < 0) {
+    app_error("init failed in eval_rounds");
+  }
+  if (arena && (a = impl->arena_create()) == NULL) {
+    app_error("arena_create failed in eval_rounds");
+  }
+
+  for (i = 0; i < trace->num_ops; i++) {
+    if (trace->ops[i].type != ALLOC) {
+      continue;
+    }
+    round[n] = arena ? (char *) impl->arena_alloc(a, trace->ops[i].size) :
+                       (char *) impl->malloc(trace->ops[i].size);
+    if (round[n] == NULL) {
+      app_error("allocation failed in eval_rounds");
+    }
+    if (++n == ARENA_ROUND) {
+      if (arena) {
+        impl->arena_reset(a);
+      } else {
+        for (j = 0; j < n; j++) {
+          impl->free(round[j]);
+        }
+      }
+      n = 0;
+    }
+  }
+  if (arena) {
+    impl->arena_destroy(a);
+  } else {
+    for (j = 0; j < n; j++) {
+      impl->free(round[j]);
+    }
+  }
+}
+
+/*
+ * arena_round_ok - check that each of the n blocks of a round still holds
+ *    the byte it was filled with
+ */
+static int arena_round_ok(char **round, const int *sizes, int n) {
+  for (int j = 0; j < n; j++) {
+    for (int k = 0; k < sizes[j]; k++) {
+      if (round[j][k] != (char) (j & 0xFF)) {
+        return 0;
+      }
+    }
+  }
+  return 1;
+}
+
+/*
+ * eval_arena_valid - Replay the rounds of eval_rounds from an arena, fill
+ *    every block with a byte of its own, and check before each reset
+ *    that no block was overwritten by another and that all are aligned
+ *    and in the heap. Returns 0 on failure, and 1 on pass.
+ */
+static int eval_arena_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
+  static char *round[ARENA_ROUND];
+  static int sizes[ARENA_ROUND];
+  arena_t *a;
+  int i, n = 0;
+
+  mem_reset_brk();
+  if (impl->init() < 0 || (a = impl->arena_create()) == NULL) {
+    malloc_error(tracenum, 0, "arena_create failed.");
+    return 0;
+  }
+  for (i = 0; i < trace->num_ops; i++) {
+    if (trace->ops[i].type != ALLOC) {
+      continue;
+    }
+    round[n] = (char *) impl->arena_alloc(a, trace->ops[i].size);
+    sizes[n] = trace->ops[i].size;
+    if (round[n] == NULL) {
+      malloc_error(tracenum, i, "arena_alloc failed.");
+      return 0;
+    }
+    if (!IS_ALIGNED(round[n]) || round[n] < (char *) mem_heap_lo() ||
+        round[n] + sizes[n] - 1 > (char *) mem_heap_hi()) {
+      malloc_error(tracenum, i, "arena block is misaligned or out of the heap.");
+      return 0;
+    }
+    memset(round[n], n & 0xFF, sizes[n]);
+    if (++n == ARENA_ROUND) {
+      if (!arena_round_ok(round, sizes, n)) {
+        malloc_error(tracenum, i, "arena blocks overlap.");
+        return 0;
+      }
+      impl->arena_reset(a);
+      n = 0;
+    }
+  }
+  if (!arena_round_ok(round, sizes, n)) {
+    malloc_error(tracenum, i, "arena blocks overlap.");
+    return 0;
+  }
+  impl->arena_destroy(a);
+  return 1;
+}
+
+/*
+ * eval_mm_arena - Check the package's arenas on the trace, then time
+ *    eval_rounds with malloc/free and with arenas
+ */
+static void eval_mm_arena(const malloc_impl_t *impl, trace_t *trace, int tracenum,
+                          arena_bench_t *bench) {
+  memset(bench, 0, sizeof(*bench));
+  if (!eval_arena_valid(impl, trace, tracenum)) {
+    return;
+  }
+  for (int i = 0; i < trace->num_ops; i++) {
+    bench->allocs += (trace->ops[i].type == ALLOC);
+  }
+  arena_impl = impl;
+  bench->free_secs = fsecs((void (*)(void *))eval_rounds_free, trace);
+  bench->free_heap = mem_heapsize();
+  bench->arena_secs = fsecs((void (*)(void *))eval_rounds_arena, trace);
+  bench->arena_heap = mem_heapsize();
+}
+
+/*
+ * eval_my_sized - Turn each free of the trace into a free_sized of the
+ *    size its block was last given, check the mm package on that and
+ *    time it. Returns the secs, or 0 if the check failed. The trace is
+ *    left as it was.
+ */
+static double eval_my_sized(trace_t *trace, int tracenum) {
+  double secs = 0;
+  int i;
+
+  for (i = 0; i < trace->num_ops; i++) {
+    if (trace->ops[i].type == FREE) {
+      trace->ops[i].type = FREE_SIZED;
+    }
+  }
+  if (eval_mm_valid(&my_impl, trace, tracenum)) {
+    if (trace->num_callocs > 0) {
+      set_fsecs_setup((void (*)(void *))clean_heap);
+    }
+    secs = fsecs((void (*)(void *))eval_my_speed, trace);
+    set_fsecs_setup(NULL);
+  }
+  for (i = 0; i < trace->num_ops; i++) {
+    if (trace->ops[i].type == FREE_SIZED) {
+      trace->ops[i].type = FREE;
+    }
+  }
+  return secs;
+}
+
+/*
+ * load_engine - dlopen an allocator engine built with make engine and
+ *    find the malloc_impl_t it exports as ENGINE_SYMBOL
+ */
+static void load_engine(engine_t *engine, char *path) {
+  memset(engine, 0, sizeof(*engine));
+  engine->path = path;
+  engine->handle = dlopen(path, RTLD_NOW | RTLD_LOCAL);
+  if (engine->handle == NULL) {
+    printf("Could not load engine %s: %s\n", path, dlerror());
+    exit(1);
+  }
+  engine->impl = (const malloc_impl_t *) dlsym(engine->handle, ENGINE_SYMBOL);
+  if (engine->impl == NULL) {
+    printf("Engine %s does not export %s\n", path, ENGINE_SYMBOL);
+    exit(1);
+  }
+}
+
+/*
+ * eval_engine - Check, and measure the utilization and throughput of,
+ *    an allocator engine on every trace, as for the mm package
+ */
+static void eval_engine(engine_t *engine, int n, char **tracefiles,
+                        char *tracedir) {
+  trace_t *trace;
+  int i;
+
+  if (verbose > 1) {
+    printf("\nTesting engine %s\n", engine->path);
+  }
+  engine->stats = (stats_t *) calloc(n, sizeof(stats_t));
+  if (engine->stats == NULL) {
+    unix_error("engine stats calloc failed");
+  }
+  engine_impl = engine->impl;
+  for (i = 0; i < n; i++) {
+    trace = read_trace(tracedir, tracefiles[i]);
+    engine->stats[i].ops = trace->num_requests;
+    engine->stats[i].valid = eval_mm_valid(engine->impl, trace, i);
+    if (engine->stats[i].valid) {
+      engine->stats[i].util =
+          eval_mm_util(engine->impl, trace, i, tracefiles[i]);
+      if (trace->num_callocs > 0) {
+        set_fsecs_setup((void (*)(void *))clean_heap);
+      }
+      engine->stats[i].secs =
+          fsecs((void (*)(void *))eval_engine_speed, trace);
+      set_fsecs_setup(NULL);
+    }
+    free_trace(trace);
+  }
+}
+
+/*
+ * eval_compiled - Time the trace compiled into mdriver by trace2c.py
+ *    (make mdriver-compiled) once through the eval_mm_speed interpreter
+ *    and once as straight-line code calling my_malloc, my_realloc and
+ *    my_free directly. The difference is the interpreter's dispatch
+ *    overhead, which the normal throughput numbers charge to the
+ *    allocator.
+ */
+static void eval_compiled(void) {
+#ifdef COMPILED_TRACE
+  trace_t *trace;
+  double interp_secs, compiled_secs;
+
+  trace = read_trace("", (char *) compiled_trace_file);
+  mem_init();
+  if (!eval_mm_valid(&my_impl, trace, 0)) {
+    app_error("mm malloc is not valid on the compiled trace");
+  }
+  if (trace->num_callocs > 0) {
+    set_fsecs_setup((void (*)(void *))clean_heap);
+  }
+  interp_secs = fsecs((void (*)(void *))eval_my_speed, trace);
+  compiled_secs = fsecs((void (*)(void *))compiled_trace_run, NULL);
+  set_fsecs_setup(NULL);
+  mem_deinit();
+
+  printf("%30s%8s%12s%12s%10s\n",
+         "filename", "ops", "secs", "Kops/sec", "ns/op");
+  printf("%30s%8d%12.6f%12.0f%10.1f\n", "interpreted",
+         compiled_trace_ops, interp_secs,
+         (compiled_trace_ops / interp_secs) / 1e3,
+         1e9 * interp_secs / compiled_trace_ops);
+  printf("%30s%8d%12.6f%12.0f%10.1f\n", "compiled",
+         compiled_trace_ops, compiled_secs,
+         (compiled_trace_ops / compiled_secs) / 1e3,
+         1e9 * compiled_secs / compiled_trace_ops);
+  printf("%s: dispatch overhead %.1f ns/op (%.0f%% of interpreted time)\n",
+         compiled_trace_file,
+         1e9 * (interp_secs - compiled_secs) / compiled_trace_ops,
+         100.0 * (interp_secs - compiled_secs) / interp_secs);
+  free_trace(trace);
+#else
+  app_error("No compiled trace; build with make mdriver-compiled TRACE=<file>");
+#endif
+}
+
+/*
+ * eval_mm_check - This function is used to check the heap of the student's
+ *    implementation.  Returns 0 on check failure, and 1 on pass.
+ */
+static int eval_mm_check(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
+  int i, index, size, newsize;
+  char *p, *newp, *oldp, *block;
+
+  /* Reset the heap and initialize the mm package */
+  mem_reset_brk();
+  if (impl->init() < 0) {
+    malloc_error(tracenum, 0, "impl init failed.");
+  }
+  /* Interpret each trace request */
+  for (i = 0; i < trace->num_ops; i++) {
+    switch (trace->ops[i].type) {
+      case ALLOC: /* malloc */
+        index = trace->ops[i].index;
+        size = trace->ops[i].size;
+        if ((p = (char *) impl->malloc(size)) == NULL) {
+          malloc_error(tracenum, i, "impl malloc failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
+      case ALLOC_ALIGNED: /* aligned_alloc */
+        index = trace->ops[i].index;
+        p = (char *) impl->aligned_alloc(trace->ops[i].align, trace->ops[i].size);
+        if (p == NULL) {
+          malloc_error(tracenum, i, "impl aligned_alloc failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
+      case CALLOC: /* calloc */
+        index = trace->ops[i].index;
+        if ((p = (char *) impl->calloc(1, trace->ops[i].size)) == NULL) {
+          malloc_error(tracenum, i, "impl calloc failed.");
+          return 0;
+        }
+        trace->blocks[index] = p;
+        break;
+
+      case REALLOC: /* realloc */
+        index = trace->ops[i].index;
+        newsize = trace->ops[i].size;
+        oldp = trace->blocks[index];
+        if ((newp = (char *) impl->realloc(oldp, newsize)) == NULL) {
+          malloc_error(tracenum, i, "impl realloc failed.");
+          return 0;
+        }
+        trace->blocks[index] = newp;
+        break;
+
+      case FREE: /* free */
+        index = trace->ops[i].index;
+        block = trace->blocks[index];
+        impl->free(block);
+        break;
+
+      case ALLOC_BATCH: /* malloc_batch */
+        index = trace->ops[i].index;
+        if (impl->malloc_batch(trace->ops[i].size, trace->ops[i].count,
+                               (void **) &trace->blocks[index]) !=
+            (size_t) trace->ops[i].count) {
+          malloc_error(tracenum, i, "impl malloc_batch failed.");
+          return 0;
+        }
+        break;
+
+      case FREE_BATCH: /* free_batch */
+        index = trace->ops[i].index;
+        impl->free_batch((void **) &trace->blocks[index], trace->ops[i].count);
+        break;
+
+      case WRITE: /* write */
+        break;
+
+      default:
+        app_error("Nonexistent request type in eval_mm_check");
+    }
+
+    if (impl->check() < 0) {
+      malloc_error(tracenum, i, "impl check failed.");
+      return 0;
+    }
+  }
+
+  return 1;
+}
+
+/*************************************
+ * Some miscellaneous helper routines
+ ************************************/
+
+
+/*
+ * printresults - prints a performance summary for some malloc package
+ */
+static void printresults(int n, char **tracefiles, stats_t *stats) {
+  int i;
+  double total_ops = 0, total_secs = 0, total_throughput = 0, total_util = 0;
+
+  /* Print the individual results for each trace */
+  printf("%5s%27s%10s%10s%6s%8s%10s%9s\n",
+         "trace", "filename", " valid", "checked", "util", "ops", "secs", "Kops/sec");
+  for (i = 0; i < n; i++) {
+    if (stats[i].valid) {
+      double throughput = (stats[i].ops/stats[i].secs)/1e3;
+      printf("%2d%30s%10s%10s%5.0f%%%8.0f%10.6f %8.0f\n",
+             i,
+             tracefiles[i],
+             "yes",
+             (stats[i].checked ? "yes" : "no"),
+             stats[i].util*100.0,
+             stats[i].ops,
+             stats[i].secs,
+             throughput);
+      total_ops += stats[i].ops;
+      total_secs += stats[i].secs;
+      total_throughput += throughput;
+      total_util += stats[i].util;
+    } else {
+      printf("%2d%30s%10s%10s%6s%8s%10s%8s\n",
+             i,
+             tracefiles[i],
+             "no",
+             (stats[i].checked ? "yes" : "no"),
+             "-",
+             "-",
+             "-",
+             "-");
+    }
+  }
+
+  /* Print the aggregate results for the set of traces */
   if (errors == 0) {
     printf("%12s%40s%5.0f%%%8.0f%10.6f %8.0f\n",
            "Average     ",
@@ -765,6 +1899,300 @@ static void printresults(int n, char **tracefiles, stats_t *stats) {
   }
 }
 
+/*
+ * printtiming - prints the spread of the timed runs behind each trace's
+ *     secs: median, median absolute deviation, 95% confidence interval of
+ *     the median and number of outlying runs. Prints nothing unless the
+ *     timer recorded individual runs.
+ */
+static void printtiming(int n, char **tracefiles, stats_t *stats) {
+  int i;
+
+  for (i = 0; i < n; i++) {
+    if (stats[i].valid && stats[i].timing.n > 0) {
+      break;
+    }
+  }
+  if (i == n) {
+    return;
+  }
+
+  printf("\n%5s%27s%6s%11s%8s%23s%5s\n",
+         "trace", "filename", "runs", "median", "MAD", "95% CI", "out");
+  for (i = 0; i < n; i++) {
+    const ftimer_stats_t *t = &stats[i].timing;
+    if (!stats[i].valid || t->n == 0) {
+      continue;
+    }
+    printf("%2d%30s%6d%11.6f%7.2f%%  [%9.6f, %9.6f]%5d\n",
+           i,
+           tracefiles[i],
+           t->n,
+           t->median,
+           (t->median > 0) ? 100.0 * t->mad / t->median : 0.0,
+           t->ci_lo,
+           t->ci_hi,
+           t->outliers);
+  }
+}
+
+/*
+ * throughput_ratio - the throughput part of a trace's score: throughput
+ *     relative to LIBC_MULTIPLIER times libc's (capped at
+ *     MAX_BASE_THROUGHPUT), at most 1
+ */
+static double throughput_ratio(const stats_t *stats, const stats_t *libc_stats) {
+  double base_throughput = LIBC_MULTIPLIER * libc_stats->ops / libc_stats->secs;
+  if (base_throughput > MAX_BASE_THROUGHPUT)
+    base_throughput = MAX_BASE_THROUGHPUT;
+  double ratio = (stats->ops / stats->secs) / base_throughput;
+  return (ratio > 1.0) ? 1.0 : ratio;
+}
+
+/*
+ * printengines - prints the utilization and throughput of the mm package
+ *     and of every -a engine side by side, and the performance index each
+ *     of them would get
+ */
+static void printengines(int n, char **tracefiles, stats_t *mm_stats,
+                         stats_t *libc_stats, engine_t *engines, int num_engines) {
+  int i, e;
+
+  printf("\nEngine comparison (util%%, Kops/sec):\n");
+  printf("%30s%20s", "engine", "mm");
+  for (e = 0; e < num_engines; e++) {
+    const char *name = strrchr(engines[e].path, '/');
+    printf("%20.19s", name ? name + 1 : engines[e].path);
+  }
+  printf("\n");
+
+  for (i = 0; i <= n; i++) {
+    printf("%30s", (i < n) ? tracefiles[i] : "perfidx");
+    for (e = -1; e < num_engines; e++) {
+      const stats_t *stats = (e < 0) ? mm_stats : engines[e].stats;
+      if (i == n) {
+        double util = 0, tput = 0;
+        for (int t = 0; t < n; t++) {
+          if (stats[t].valid) {
+            util += stats[t].util;
+            tput += throughput_ratio(&stats[t], &libc_stats[t]);
+          }
+        }
+        printf("%20.2f", 100.0 * (UTIL_WEIGHT * util +
+                                  (1.0 - UTIL_WEIGHT) * tput) / n);
+      } else if (stats[i].valid) {
+        printf("%11.0f%%%8.0f", stats[i].util * 100,
+               (stats[i].ops / stats[i].secs) / 1e3);
+      } else {
+        printf("%20s", "invalid");
+      }
+    }
+    printf("\n");
+  }
+}
+
+/*
+ * printsplit - prints how each trace's time divides between the allocator
+ *     (the trace replayed without its writes) and the simulated writes
+ *     (the difference to the full replay). Traces without writes are
+ *     not timed twice, so all of their time is allocator time.
+ */
+static void printsplit(int n, char **tracefiles, stats_t *stats) {
+  int i;
+
+  printf("%5s%27s%11s%11s%11s%8s%14s\n",
+         "trace", "filename", "alloc secs", "write secs", "total secs",
+         "alloc%", "alloc Kops/s");
+  for (i = 0; i < n; i++) {
+    if (!stats[i].valid) {
+      continue;
+    }
+    double write_secs = stats[i].secs - stats[i].alloc_secs;
+    if (write_secs < 0) {
+      write_secs = 0;
+    }
+    printf("%2d%30s%11.6f%11.6f%11.6f%7.0f%%%14.0f\n",
+           i,
+           tracefiles[i],
+           stats[i].alloc_secs,
+           write_secs,
+           stats[i].secs,
+           100.0 * stats[i].alloc_secs / stats[i].secs,
+           (stats[i].alloc_ops / stats[i].alloc_secs) / 1e3);
+  }
+}
+
+/*
+ * printarena - prints the throughput and heap size of the mallocs of each
+ *     trace released in rounds, by free and by arena_reset
+ */
+static void printarena(int n, char **tracefiles, stats_t *stats) {
+  int i;
+
+  printf("%5s%27s%8s%13s%13s%9s%11s%11s\n",
+         "trace", "filename", "mallocs", "free Kops/s", "arena Kops/s",
+         "speedup", "free KB", "arena KB");
+  for (i = 0; i < n; i++) {
+    const arena_bench_t *b = &stats[i].arena;
+    if (!stats[i].valid || b->allocs == 0) {
+      continue;
+    }
+    printf("%2d%30s%8d%13.0f%13.0f%8.2fx%11.0f%11.0f\n",
+           i,
+           tracefiles[i],
+           b->allocs,
+           (b->allocs / b->free_secs) / 1e3,
+           (b->allocs / b->arena_secs) / 1e3,
+           b->free_secs / b->arena_secs,
+           b->free_heap / 1024.0,
+           b->arena_heap / 1024.0);
+  }
+}
+
+/*
+ * printsized - prints the throughput of each trace freed by free and by
+ *     free_sized
+ */
+static void printsized(int n, char **tracefiles, stats_t *stats) {
+  int i;
+
+  printf("%5s%27s%10s%13s%13s%9s\n",
+         "trace", "filename", "ops", "free Kops/s", "sized Kops/s", "speedup");
+  for (i = 0; i < n; i++) {
+    if (!stats[i].valid) {
+      continue;
+    }
+    if (stats[i].sized_secs == 0) {
+      printf("%2d%30s%10.0f%13.0f%13s%9s\n", i, tracefiles[i], stats[i].ops,
+             (stats[i].ops / stats[i].secs) / 1e3, "invalid", "-");
+      continue;
+    }
+    printf("%2d%30s%10.0f%13.0f%13.0f%8.2fx\n",
+           i,
+           tracefiles[i],
+           stats[i].ops,
+           (stats[i].ops / stats[i].secs) / 1e3,
+           (stats[i].ops / stats[i].sized_secs) / 1e3,
+           stats[i].secs / stats[i].sized_secs);
+  }
+}
+
+/*
+ * printlocality - prints the cost of walking the live blocks at each
+ *     trace's peak in allocation order and in id order
+ */
+static void printlocality(int n, char **tracefiles, stats_t *stats) {
+  int i;
+
+  printf("%5s%27s%9s%12s%14s%14s\n",
+         "trace", "filename", "blocks", "stride", "alloc cyc/hop",
+         "id cyc/hop");
+  for (i = 0; i < n; i++) {
+    const locality_t *loc = &stats[i].locality;
+    if (!stats[i].valid || loc->blocks == 0) {
+      continue;
+    }
+    printf("%2d%30s%9d%12.0f%14.2f%14.2f\n",
+           i,
+           tracefiles[i],
+           loc->blocks,
+           loc->stride,
+           loc->alloc_cycles,
+           loc->id_cycles);
+  }
+}
+
+/*
+ * printcounters - prints the hardware counters of each trace divided by
+ *     its number of ops, next to its throughput. Counters that could not
+ *     be opened are shown as "-".
+ */
+static void printcounters(int n, char **tracefiles, stats_t *stats) {
+  int i, e;
+
+  printf("%5s%27s%9s", "trace", "filename", "Kops/sec");
+  for (e = 0; e < PERFCTR_NUM; e++) {
+    printf("%10s", perfctr_name(e));
+  }
+  printf("%6s\n", "IPC");
+  for (i = 0; i < n; i++) {
+    const perfctr_values_t *c = &stats[i].counters;
+    if (!stats[i].valid) {
+      continue;
+    }
+    printf("%2d%30s%9.0f", i, tracefiles[i],
+           (stats[i].ops/stats[i].secs)/1e3);
+    for (e = 0; e < PERFCTR_NUM; e++) {
+      if (c->valid[e]) {
+        printf("%10.2f", c->counts[e] / stats[i].ops);
+      } else {
+        printf("%10s", "-");
+      }
+    }
+    if (c->valid[PERFCTR_CYCLES] && c->valid[PERFCTR_INSTRUCTIONS] &&
+        c->counts[PERFCTR_CYCLES] > 0) {
+      printf("%6.2f\n", (double) c->counts[PERFCTR_INSTRUCTIONS] /
+             c->counts[PERFCTR_CYCLES]);
+    } else {
+      printf("%6s\n", "-");
+    }
+  }
+}
+
+/*
+ * printallocstats - prints the allocator's own statistics after one
+ *     replay of a trace
+ */
+static void printallocstats(const char *tracefile, const malloc_stats_t *st) {
+  int k;
+
+  printf("\nAllocator statistics for %s:\n", tracefile);
+  if (st == NULL) {
+    printf("  not available\n");
+    return;
+  }
+  if (st->has_counters) {
+    printf("  mallocs %zu, nodes visited %zu (%.2f per malloc)\n",
+           st->mallocs, st->nodes_visited,
+           st->mallocs ? (double) st->nodes_visited / st->mallocs : 0.0);
+    printf("  splits %zu, coalesces %zu\n", st->splits, st->coalesces);
+    printf("  mem_sbrk calls %zu, bytes %zu\n", st->sbrk_calls, st->sbrk_bytes);
+    printf("  realloc in place %zu, copied %zu (%zu bytes)\n",
+           st->realloc_in_place, st->realloc_copies, st->realloc_bytes_copied);
+    printf("  mallocs from hot-size caches %zu, from the last remainder %zu\n",
+           st->hot_hits, st->victim_hits);
+    if (st->calloc_bytes > 0) {
+      printf("  calloc bytes %zu, zeroed %zu (%.1f%%)\n", st->calloc_bytes,
+             st->calloc_zeroed, 100.0 * st->calloc_zeroed / st->calloc_bytes);
+    }
+  } else {
+    printf("  counters not compiled in (rebuild with make STATS=1)\n");
+  }
+  if (st->profile != NULL) {
+    printf("  workload profile %s\n", st->profile);
+  }
+  if (st->long_lived_heap > 0) {
+    printf("  mallocs predicted long-lived %zu, their region %zu bytes\n",
+           st->long_lived, st->long_lived_heap);
+  }
+  printf("  free blocks %zu, free bytes %zu, largest %zu\n",
+         st->free_blocks, st->free_bytes, st->largest_free);
+  printf("  free blocks per bin:");
+  for (k = 0; k < st->num_bins && k < MALLOC_STATS_BINS; k++) {
+    if (st->bin_blocks[k] > 0) {
+      printf(" [%d] %zu (%zu B)", k, st->bin_blocks[k], st->bin_bytes[k]);
+    }
+  }
+  printf("\n");
+  printf("  bins not using best fit:");
+  for (k = 0; k < st->num_bins && k < MALLOC_STATS_BINS; k++) {
+    if (st->bin_policy[k] != 0 && st->bin_policy[k] != 'b') {
+      printf(" [%d] %s", k, st->bin_policy[k] == 'f' ? "first" : "next");
+    }
+  }
+  printf("\n");
+}
+
 /*
  * app_error - Report an arbitrary application error
  */
@@ -793,7 +2221,7 @@ void malloc_error(int tracenum, int opnum, char *msg) {
  * usage - Explain the command line arguments
  */
 static void usage(void) {
-  fprintf(stderr, "Usage: mdriver [-hvVgc] [-f <file>] [-t <dir>]\n");
+  fprintf(stderr, "Usage: mdriver [-hvVgclPsSoCA] [-f <file>] [-t <dir>] [-w <n>] [-r <n>] [-p <cpu>] [-L <file>] [-u <file>] [-n <ops>] [-a <engine.so>]...\n");
   fprintf(stderr, "Options\n");
   fprintf(stderr, "\t-f <file>  Use <file> as the trace file.\n");
   fprintf(stderr, "\t-t <dir>   Directory to find default traces.\n");
@@ -801,5 +2229,20 @@ static void usage(void) {
   fprintf(stderr, "\t-v         Print per-trace performance breakdowns.\n");
   fprintf(stderr, "\t-V         Print additional debug info.\n");
   fprintf(stderr, "\t-c         Check the heap after every operation.\n");
+  fprintf(stderr, "\t-w <n>     Untimed warm-up runs per trace.\n");
+  fprintf(stderr, "\t-r <n>     Timed runs per trace.\n");
+  fprintf(stderr, "\t-p <cpu>   Pin mdriver to <cpu> while measuring.\n");
+  fprintf(stderr, "\t-l         Print per-op latency percentiles.\n");
+  fprintf(stderr, "\t-L <file>  Like -l, and also write them to <file> as CSV.\n");
+  fprintf(stderr, "\t-P         Print hardware performance counters per op.\n");
+  fprintf(stderr, "\t-a <.so>   Also evaluate an allocator engine (make engine); repeatable.\n");
+  fprintf(stderr, "\t-C         Compare interpreted and compiled replay (mdriver-compiled).\n");
+  fprintf(stderr, "\t-o         Time walking the live blocks in allocation and id order.\n");
+  fprintf(stderr, "\t-S         Also time each trace without its writes.\n");
+  fprintf(stderr, "\t-A         Time the mallocs of each trace released by arenas vs. free.\n");
+  fprintf(stderr, "\t-z         Check each trace with free_sized instead of free, and time it.\n");
+  fprintf(stderr, "\t-s         Print allocator statistics (counters need make STATS=1).\n");
+  fprintf(stderr, "\t-u <file>  Write a utilization timeline of each trace to <file> as CSV.\n");
+  fprintf(stderr, "\t-n <ops>   Ops between utilization timeline samples (default 1000).\n");
   fprintf(stderr, "\t-h         Print this message.\n");
 }
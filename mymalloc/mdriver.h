@@ -47,7 +47,10 @@
 #define HDRLINES       4 /* number of header lines in a trace file */
 #define LINENUM(i) (i+5) /* cnvt trace request nums to linenums (origin 1) */
 
-typedef enum {ALLOC, FREE, REALLOC, WRITE} traceop_type; /* type of request */
+/* type of request; ALLOC_BATCH and FREE_BATCH cover count ids from index.
+ * No trace has FREE_SIZED: mdriver -z turns each FREE into one. */
+typedef enum {ALLOC, FREE, REALLOC, WRITE, ALLOC_BATCH, FREE_BATCH,
+              ALLOC_ALIGNED, CALLOC, FREE_SIZED, NUM_TRACEOP_TYPES} traceop_type;
 /******************************
  * The key compound data types
  *****************************/
@@ -56,7 +59,12 @@ typedef enum {ALLOC, FREE, REALLOC, WRITE} traceop_type; /* type of request */
 typedef struct {
   traceop_type  type; /* type of request */
   int index;                        /* index for free() to use later */
-  int size;                         /* byte size of alloc/realloc request */
+  int size;                         /* byte size of alloc/realloc request,
+                                       or of the block a free releases */
+  union {
+    int count;                      /* blocks of a batch request */
+    int align;                      /* alignment of an aligned alloc */
+  };
 } traceop_t;
 
 /* Holds the information for one trace file*/
@@ -64,6 +72,8 @@ typedef struct {
   int sugg_heapsize;   /* suggested heap size (unused) */
   int num_ids;         /* number of alloc/realloc ids */
   int num_ops;         /* number of distinct requests */
+  int num_requests;    /* num_ops, counting each block of a batch */
+  int num_callocs;     /* calloc requests */
   int weight;          /* weight for this trace (unused) */
   traceop_t *ops;      /* array of requests */
   char **blocks;       /* array of ptrs returned by malloc/realloc... */
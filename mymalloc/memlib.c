@@ -38,21 +38,50 @@
 
 /* private variables */
 static char *mem_start_brk;  /* points to first byte of heap */
-static char *mem_brk;        /* points to last byte of heap */
 static char *mem_max_addr;   /* largest legal heap address */
 
+/*
+ * The heap is MEM_REGIONS regions that grow independently, so that an
+ * allocator can keep apart blocks it doesn't want mixed. Region 0 starts
+ * at mem_start_brk and is the one mem_sbrk grows; the others take
+ * MEM_REGION_SIZE bytes each at the top of the storage. The heap size is
+ * what all of them use, and the heap extends from the start of region 0
+ * to the end of the highest region in use.
+ *
+ * Like pages fresh from the kernel, memory that has not been in the heap
+ * reads as zero: the storage starts zeroed, and each region remembers in
+ * clean how far it ever grew, until mem_clean zeroes that again.
+ */
+typedef struct {
+  char *start;  /* points to first byte of the region */
+  char *brk;    /* points to last byte of the region */
+  char *max;    /* largest legal address of the region */
+  char *clean;  /* memory from here up has not been in the heap */
+} mem_region;
+
+static mem_region regions[MEM_REGIONS];
+
 /*
  * mem_init - initialize the memory system model
  */
 void mem_init(void) {
   /* allocate the storage we will use to model the available VM */
-  if ((mem_start_brk = (char *)malloc(MAX_HEAP)) == NULL) {
+  if ((mem_start_brk = (char *)calloc(1, MAX_HEAP)) == NULL) {
     fprintf(stderr, "mem_init_vm: malloc error\n");
     exit(1);
   }
 
   mem_max_addr = mem_start_brk + MAX_HEAP;  /* max legal heap address */
-  mem_brk = mem_start_brk;                  /* heap is empty initially */
+  regions[0].start = mem_start_brk;
+  regions[0].max = mem_max_addr - (MEM_REGIONS - 1) * MEM_REGION_SIZE;
+  for (int r = 1; r < MEM_REGIONS; r++) {
+    regions[r].start = regions[r - 1].max;
+    regions[r].max = regions[r].start + MEM_REGION_SIZE;
+  }
+  for (int r = 0; r < MEM_REGIONS; r++) {
+    regions[r].clean = regions[r].start;
+  }
+  mem_reset_brk();                          /* heap is empty initially */
 }
 
 /*
@@ -66,7 +95,9 @@ void mem_deinit(void) {
  * mem_reset_brk - reset the simulated brk pointer to make an empty heap
  */
 void mem_reset_brk(void) {
-  mem_brk = mem_start_brk;
+  for (int r = 0; r < MEM_REGIONS; r++) {
+    regions[r].brk = regions[r].start;
+  }
 }
 
 /*
@@ -75,22 +106,43 @@ void mem_reset_brk(void) {
  *    this model, the heap cannot be shrunk.
  */
 void *mem_sbrk(int incr) {
-  char *old_brk = __sync_fetch_and_add(&mem_brk, incr);
+  return mem_region_sbrk(0, incr);
+}
+
+/* Is region one of the regions? An engine may ask for one that isn't. */
+#define MEM_REGION_OK(region) ((region) >= 0 && (region) < MEM_REGIONS)
 
-  if ((incr < 0) || (mem_brk > mem_max_addr)) {
+/*
+ * mem_region_sbrk - mem_sbrk for the given region
+ */
+void *mem_region_sbrk(int region, int incr) {
+  if (!MEM_REGION_OK(region)) {
+    errno = ENOMEM;
+    return (void *)-1;
+  }
+  mem_region *m = &regions[region];
+  char *old_brk = __sync_fetch_and_add(&m->brk, incr);
+
+  if ((incr < 0) || (m->brk > m->max)) {
     errno = ENOMEM;
-    fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory... (%ld)\n", mem_heapsize());
+    /* The other regions are extras, which an allocator can do without */
+    if (region == 0) {
+      fprintf(stderr, "ERROR: mem_sbrk failed. Ran out of memory... (%ld)\n", mem_heapsize());
+    }
 
 #pragma GCC diagnostic push
 #pragma GCC diagnostic ignored "-Wunused-value"
 
-    __sync_fetch_and_add(&mem_brk, -incr);
+    __sync_fetch_and_add(&m->brk, -incr);
 
 #pragma GCC diagnostic pop
 
     return (void *)-1;
   }
 
+  if (m->brk > m->clean) {
+    m->clean = m->brk;
+  }
   return (void *)old_brk;
 }
 
@@ -102,18 +154,73 @@ void *mem_heap_lo(void) {
 }
 
 /*
- * mem_heap_hi - returns the address of the first byte past the end of the
- *    heap.
+ * mem_heap_hi - returns the address of the last heap byte, the end of the
+ *    highest region in use
  */
 void *mem_heap_hi(void) {
-  return (void *)(mem_brk - 1);
+  for (int r = MEM_REGIONS - 1; r > 0; r--) {
+    if (regions[r].brk != regions[r].start) return mem_region_hi(r);
+  }
+  return mem_region_hi(0);
 }
 
 /*
- * mem_heapsize() - returns the heap size in bytes
+ * mem_heapsize() - returns the heap size in bytes, over all regions
  */
 size_t mem_heapsize(void) {
-  return (size_t)(mem_brk - mem_start_brk);
+  size_t size = 0;
+  for (int r = 0; r < MEM_REGIONS; r++) {
+    size += mem_region_size(r);
+  }
+  return size;
+}
+
+/*
+ * mem_region_lo - return address of the first byte of the region
+ */
+void *mem_region_lo(int region) {
+  if (!MEM_REGION_OK(region)) return (void *)-1;
+  return (void *)regions[region].start;
+}
+
+/*
+ * mem_region_hi - return address of the last byte of the region
+ */
+void *mem_region_hi(int region) {
+  if (!MEM_REGION_OK(region)) return (void *)-1;
+  return (void *)(regions[region].brk - 1);
+}
+
+/*
+ * mem_region_size - returns the bytes the region uses
+ */
+size_t mem_region_size(int region) {
+  if (!MEM_REGION_OK(region)) return 0;
+  return (size_t)(regions[region].brk - regions[region].start);
+}
+
+/*
+ * mem_region_clean - return the address from which the region has not been
+ *    in the heap since mem_init or mem_clean, and so reads as zero
+ */
+void *mem_region_clean(int region) {
+  if (!MEM_REGION_OK(region)) return (void *)-1;
+  return (void *)regions[region].clean;
+}
+
+/*
+ * mem_clean - zero what the regions used beyond their current break, as
+ *    the kernel would for a new process. After mem_reset_brk, the whole
+ *    heap is clean again.
+ */
+void mem_clean(void) {
+  for (int r = 0; r < MEM_REGIONS; r++) {
+    mem_region *m = &regions[r];
+    if (m->clean > m->brk) {
+      memset(m->brk, 0, m->clean - m->brk);
+      m->clean = m->brk;
+    }
+  }
 }
 
 /*
@@ -34,4 +34,11 @@ void *mem_heap_hi(void);
 size_t mem_heapsize(void);
 size_t mem_pagesize(void);
 
+void *mem_region_sbrk(int region, int incr);
+void *mem_region_lo(int region);
+void *mem_region_hi(int region);
+size_t mem_region_size(int region);
+void *mem_region_clean(int region);
+void mem_clean(void);
+
 #endif  // MM_MEMLIB_H
@@ -1,6 +1,7 @@
 #!/usr/bin/env python
 #
 from opentuner import ConfigurationManipulator
+from opentuner.search.manipulator import IntegerParameter
 from opentuner.search.manipulator import PowerOfTwoParameter
 
 mdriver_manipulator = ConfigurationManipulator()
@@ -9,7 +10,9 @@ mdriver_manipulator = ConfigurationManipulator()
 See opentuner/search/manipulator.py for more parameter types,
 like IntegerParameter, EnumParameter, etc.
 
-TODO(project3): Implement the parameters of your allocator. Once
-you have at least one other parameters, feel free to remove ALIGNMENT.
+Each parameter is passed to the allocator as -D NAME=value, or with
+opentuner_run.py --runtime-params as the environment variable NAME read by
+bfl_params_load, so names must match the macros in bfl.h.
 """
-mdriver_manipulator.add_parameter(PowerOfTwoParameter('ALIGNMENT', 8, 8))
+mdriver_manipulator.add_parameter(PowerOfTwoParameter('BFL_MIN_BLOCK_SIZE', 32, 256))
+mdriver_manipulator.add_parameter(IntegerParameter('BFL_MIN_SPLIT_SIZE', 32, 1024))
@@ -1,7 +1,11 @@
 #!/usr/bin/python2.7
 #
+import atexit
+import json
 import logging
 import os
+import shutil
+import tempfile
 import threading
 import opentuner
 from opentuner import ConfigurationManipulator
@@ -24,6 +28,24 @@ def try_num(s):
             return s
 
 
+# The smallest block: a free Node and its right header (bfl.h).
+MIN_BLOCK = 32
+
+
+# Round and clamp cfg as bfl_params_use does at runtime, so that the
+# compile-time build, the --runtime-params run and --freeze all use the
+# same values (bfl.h rejects the raw ones at compile time).
+def normalize(cfg):
+    cfg = dict(cfg)
+    align = lambda v: (v + 7) // 8 * 8
+    if 'BFL_MIN_BLOCK_SIZE' in cfg:
+        cfg['BFL_MIN_BLOCK_SIZE'] = max(align(cfg['BFL_MIN_BLOCK_SIZE']), MIN_BLOCK)
+    if 'BFL_MIN_SPLIT_SIZE' in cfg:
+        cfg['BFL_MIN_SPLIT_SIZE'] = max(align(cfg['BFL_MIN_SPLIT_SIZE']),
+                                        cfg.get('BFL_MIN_BLOCK_SIZE', 64))
+    return cfg
+
+
 # Parse stdout from mdriver when executed locally.
 def parse_stdout(stdout):
     result = {}
@@ -54,6 +76,13 @@ class MdriverTuner(MeasurementInterface):
 
   # Remember best parameters through commands.
   best_make_cmd = best_bin_cmd = ''
+  best_cfg = None
+
+  # With --runtime-params, mdriver is only built once.
+  built = False
+
+  # Non-dominated (util, kops) configurations, with --pareto.
+  front = []
 
   # Lock that protects the previous fields.
   lock = threading.Lock()
@@ -62,6 +91,19 @@ class MdriverTuner(MeasurementInterface):
     # Ensure either a file or directory is specified.
     assert args.trace_file != None or args.trace_dir != None
 
+    # Prefix lengths to score candidates on before the full traces.
+    self.fidelities = sorted(float(f) for f in args.fidelities.split(',')
+                             if float(f) < 1.0) + [1.0]
+    self.prefix_dirs = make_prefix_dirs(args, self.fidelities[:-1])
+    rungs = len(self.fidelities) - 1
+    self.rung_scores = [[] for _ in range(rungs)]  # prefix scores per rung
+    self.rung_full = [[] for _ in range(rungs)]    # (prefix, full) pairs
+
+    # Keep adding to the front of earlier runs, e.g. with another weight.
+    if args.pareto and os.path.exists(args.pareto):
+      with open(args.pareto) as f:
+        self.front = json.load(f)
+
     # Maximize perfidx, and cache the fixed inputs.
     super(MdriverTuner, self).__init__(
       args,
@@ -88,8 +130,73 @@ class MdriverTuner(MeasurementInterface):
     print 'make_cmd: ' + self.best_make_cmd
     print 'bin_cmd: ' + self.best_bin_cmd
     print 'perfidx: ' + str(self.best_accuracy)
+    if self.args.freeze and self.best_cfg is not None:
+      self.freeze(self.best_cfg)
+      print 'frozen: ' + self.args.freeze + ' (build with make FROZEN=1)'
+    if self.args.pareto:
+      with open(self.args.pareto, 'w') as f:
+        json.dump(sorted(self.front, key=lambda p: p['util']), f, indent=2)
+      print 'pareto: {0} configurations in {1}'.format(len(self.front),
+                                                       self.args.pareto)
     print
 
+  def freeze(self, cfg):
+    """
+    Write the winning configuration as compile-time constants, which bfl.h
+    picks up when built with make FROZEN=1
+    """
+    with open(self.args.freeze, 'w') as f:
+      f.write('// Generated by opentuner_run.py --freeze; perfidx {0}\n'.format(
+          self.best_accuracy))
+      f.write('#ifndef _TUNED_PARAMS_H\n#define _TUNED_PARAMS_H\n\n')
+      for key, value in sorted(cfg.iteritems()):
+        f.write('#define {0} {1}\n'.format(key, value))
+      f.write('\n#endif  // _TUNED_PARAMS_H\n')
+
+  def add_to_front(self, cfg, result):
+    """
+    Keep cfg if no known configuration has both better utilization and
+    better throughput, and drop those it beats on both
+    """
+    if 'util' not in result or 'kops' not in result:
+      return
+    point = {'util': result['util'], 'kops': result['kops'],
+             'perfidx': result.get('perfidx', 0), 'cfg': cfg}
+    def dominates(a, b):
+      return (a['util'] >= b['util'] and a['kops'] >= b['kops'] and
+              (a['util'] > b['util'] or a['kops'] > b['kops']))
+    with self.lock:
+      if any(dominates(p, point) or (p['util'] == point['util'] and
+                                     p['kops'] == point['kops'])
+             for p in self.front):
+        return
+      self.front = [p for p in self.front if not dominates(point, p)]
+      self.front.append(point)
+
+  def score(self, result):
+    """
+    The value opentuner maximizes: perfidx, or with --util-weight the
+    utilization and throughput weighted as requested
+    """
+    if self.args.util_weight is None or 'util' not in result:
+      return result.get('perfidx', 0)
+    w = self.args.util_weight
+    return w * result['util'] + (1 - w) * result.get('tput', 0)
+
+  def build(self, make_cmd):
+    """
+    Run make_cmd, or with --runtime-params only the first time
+    """
+    if not self.args.runtime_params:
+      return self.call_program(make_cmd, limit = self.args.make_timeout)
+    with self.lock:
+      if not self.built:
+        result = self.call_program(make_cmd, limit = self.args.make_timeout)
+        if result['returncode'] != 0:
+          return result
+        self.built = True
+    return {'returncode': 0}
+
   def run(self, desired_result, input, limit):
     """
     Compile and run a given configuration then
@@ -97,7 +204,7 @@ class MdriverTuner(MeasurementInterface):
     """
     accuracy = 0
     time = 0
-    cfg = desired_result.configuration.data
+    cfg = normalize(desired_result.configuration.data)
 
     # Tell the user whether the command is running locally.
     awsrun = self.args.awsrun
@@ -106,23 +213,48 @@ class MdriverTuner(MeasurementInterface):
     else:
         print "Running locally..."
 
-    # Generate the params to pass to compiler from the requested configuration.
+    # Generate the params to pass to the compiler, or with --runtime-params
+    # to the environment of mdriver, from the requested configuration.
     gcc_params = ''
+    env_params = ''
     for key, value in cfg.iteritems():
       gcc_params += '-D {0}={1} '.format(key, value)
+      env_params += '{0}={1} '.format(key, value)
     make_cmd = ''
 
     # Generate the make command.
+    if self.args.runtime_params:
+        gcc_params = ''
+        make_flags = 'TUNABLE=1'
+    else:
+        env_params = ''
+        make_flags = ''
     if awsrun:
-        make_cmd = 'make partial_clean mdriver GETTIME=1 DEBUG=0 PARAMS="{0}"'.format(gcc_params)
+        make_cmd = 'make partial_clean mdriver GETTIME=1 DEBUG=0 {0} PARAMS="{1}"'.format(make_flags, gcc_params)
     else:
-        make_cmd = 'make partial_clean mdriver DEBUG=0 PARAMS="{0}"'.format(gcc_params)
+        make_cmd = 'make partial_clean mdriver DEBUG=0 {0} PARAMS="{1}"'.format(make_flags, gcc_params)
 
     # Make the executable, on failure return 0 perfidx.
-    compile_result = self.call_program(make_cmd, limit = self.args.make_timeout)
+    compile_result = self.build(make_cmd)
     if compile_result['returncode'] != 0:
       return Result(accuracy=accuracy, time=time)
 
+    if env_params:
+        env_params = 'env ' + env_params
+
+    # With --fidelities, first score the configuration on trace prefixes,
+    # and only carry on to the full traces while it ranks among the best
+    # seen at each prefix length (asynchronous successive halving).
+    lows = []
+    for rung, fraction in enumerate(self.fidelities[:-1]):
+        trace_params = '-t ' + self.prefix_dirs[fraction]
+        result, low_time, _ = self.run_mdriver(env_params, trace_params)
+        low = self.score(result)
+        time += low_time
+        lows.append(low)
+        if not self.promote(rung, low):
+            return Result(accuracy=self.calibrate(rung, low), time=time)
+
     # Generate the mdriver option for traces.
     trace_params = ''
     if self.args.trace_file is not None:
@@ -130,58 +262,149 @@ class MdriverTuner(MeasurementInterface):
     else:
         trace_params = '-t ' + self.args.trace_dir
 
+    result, run_time, bin_cmd = self.run_mdriver(env_params, trace_params)
+    accuracy = self.score(result)
+    time += run_time
+    if self.args.pareto:
+        self.add_to_front(cfg, result)
+
+    # Update the best results if needed.
+    with self.lock:
+        for rung, low in enumerate(lows):
+            self.rung_full[rung].append((low, accuracy))
+        if accuracy > self.best_accuracy:
+            self.best_accuracy = accuracy
+            self.best_make_cmd = make_cmd
+            self.best_bin_cmd = bin_cmd
+            self.best_cfg = cfg
+
+    return Result(accuracy=accuracy, time=time)
+
+  def run_mdriver(self, env_params, trace_params):
+    """
+    Run mdriver -g on the given traces and return its summary fields
+    (empty on failure), the time it took and the command
+    """
+    result = {}
+    time = 0
+
     # Generate the mdriver command.
     bin_cmd = ''
-    if awsrun:
-        bin_cmd = 'awsrun ./mdriver -g ' + trace_params
+    if self.args.awsrun:
+        bin_cmd = 'awsrun ' + env_params + './mdriver -g ' + trace_params
     else:
-        bin_cmd = './mdriver -g ' + trace_params
+        bin_cmd = env_params + './mdriver -g ' + trace_params
 
     # Run the command.
     run_result = self.call_program(bin_cmd, limit = self.args.command_timeout)
 
-    if awsrun:
+    if self.args.awsrun:
         # Parse the output.
         result = parse_awsrun_stdout(run_result['stdout'])
 
         # Reject if the command never gives statistics.
         if len(result) < 3 or 'runtime' not in result:
-            return Result(accuracy=accuracy, time=time)
+            return {}, time, bin_cmd
 
         # Fetch the statistics.
         time += result['runtime']
-        accuracy = result.get('perfidx', accuracy)
-
-        # Update the best results if needed.
-        with self.lock:
-            if accuracy > self.best_accuracy:
-                self.best_accuracy = accuracy
-                self.best_make_cmd = make_cmd
-                self.best_bin_cmd = bin_cmd
-
-        return Result(accuracy=accuracy, time=time)
     else:
         # Get the run time.
         time += run_result['time']
 
         # Reject if the command times out or fails.
         if run_result['timeout'] or run_result['returncode'] != 0:
-            return Result(accuracy=accuracy, time=time)
+            return result, time, bin_cmd
 
         # Parse the output.
         result = parse_stdout(run_result['stdout'])
 
-        # Get the perfidx if it exists.
-        accuracy = result.get('perfidx', accuracy)
+    return result, time, bin_cmd
 
-        # Update the best results if needed.
-        with self.lock:
-            if accuracy > self.best_accuracy:
-                self.best_accuracy = accuracy
-                self.best_make_cmd = make_cmd
-                self.best_bin_cmd = bin_cmd
+  def promote(self, rung, score):
+    """
+    Record a prefix score and decide whether the configuration goes on to
+    the next fidelity: always during warm-up, then only when it is in the
+    top --promote-fraction of the scores seen at this rung
+    """
+    with self.lock:
+      scores = self.rung_scores[rung]
+      scores.append(score)
+      if len(scores) <= self.args.warmup_configs:
+        return True
+      rank = sum(1 for s in scores if s > score)
+      return rank < self.args.promote_fraction * len(scores)
+
+  def calibrate(self, rung, score):
+    """
+    Map the prefix score of a configuration that was not promoted onto the
+    full-trace scale, using the configurations that were, so that the
+    search still learns from it. It is kept below the best full score, so
+    it can never be reported as the winner.
+    """
+    with self.lock:
+      pairs = [(low, full) for low, full in self.rung_full[rung] if low > 0]
+      if pairs:
+        score *= sum(full for _, full in pairs) / sum(low for low, _ in pairs)
+      return min(score, self.best_accuracy * 0.999)
 
-        return Result(accuracy=accuracy, time=time)
+
+def write_prefix_trace(src, dst, fraction):
+    """
+    Write the first fraction of the requests in trace src to dst, with the
+    block ids renumbered densely, as mdriver requires
+    """
+    with open(src) as f:
+        tokens = f.read().split()
+    num_ops = int(tokens[2])
+    keep = max(1, int(num_ops * fraction))
+    ids = {}
+    lines = []
+    i = 4
+    while i < len(tokens) and len(lines) < keep:
+        kind = tokens[i]
+        width = {'f': 2, 'F': 3, 'A': 4, 'm': 4}.get(kind, 3)
+        if kind in ('A', 'F'):
+            # Batches cover ids first..first+count-1
+            first, count = int(tokens[i + 1]), int(tokens[i + 2])
+            new = [ids.setdefault(str(first + j), len(ids)) for j in range(count)]
+            if new == list(range(new[0], new[0] + count)):
+                lines.append(' '.join([kind, str(new[0])] + tokens[i + 2:i + width]))
+            else:
+                # Renumbered apart: one request per block
+                for index in new:
+                    lines.append(' '.join([kind.lower(), str(index)] +
+                                          tokens[i + 3:i + width]))
+        else:
+            index = ids.setdefault(tokens[i + 1], len(ids))
+            lines.append(' '.join([kind, str(index)] + tokens[i + 2:i + width]))
+        i += width
+    with open(dst, 'w') as f:
+        f.write('{0}\n{1}\n{2}\n{3}\n'.format(tokens[0], len(ids), len(lines),
+                                                 tokens[3]))
+        f.write('\n'.join(lines) + '\n')
+
+
+def make_prefix_dirs(args, fractions):
+    """
+    Down-sample every trace to each fraction, one directory per fraction
+    """
+    if args.trace_file is not None:
+        sources = [args.trace_file]
+    else:
+        sources = [os.path.join(args.trace_dir, name)
+                   for name in sorted(os.listdir(args.trace_dir))
+                   if not name.startswith('.')]
+    root = tempfile.mkdtemp(prefix='mdriver_prefix_')
+    atexit.register(shutil.rmtree, root, True)
+    dirs = {}
+    for fraction in fractions:
+        dirs[fraction] = os.path.join(root, 'f{0}'.format(fraction))
+        os.mkdir(dirs[fraction])
+        for src in sources:
+            write_prefix_trace(src, os.path.join(dirs[fraction],
+                                                 os.path.basename(src)), fraction)
+    return dirs
         
 
 if __name__ == '__main__':
@@ -198,5 +421,28 @@ if __name__ == '__main__':
                          help = 'timeout for a make invocation in seconds')
   argparser.add_argument('--awsrun', action = 'store_true',
                          help = 'run on AWS worker machines instead of local')
+  argparser.add_argument('--runtime-params', action = 'store_true',
+                         help = 'build once with TUNABLE=1 and pass parameters '
+                                'through the environment instead of recompiling')
+  argparser.add_argument('--fidelities', default = '1.0',
+                         help = 'comma-separated fractions of each trace to score '
+                                'a configuration on before the full traces, '
+                                'e.g. 0.05,0.25')
+  argparser.add_argument('--promote-fraction', type = float, default = 0.3,
+                         help = 'fraction of configurations promoted from one '
+                                'fidelity to the next')
+  argparser.add_argument('--warmup-configs', type = int, default = 5,
+                         help = 'configurations always promoted at each fidelity '
+                                'before ranking starts')
+  argparser.add_argument('--pareto', default = None,
+                         help = 'JSON file to keep every configuration not beaten '
+                                'on both utilization and throughput in; runs '
+                                'add to the front already in it')
+  argparser.add_argument('--util-weight', type = float, default = None,
+                         help = 'maximize util-weight * util + (1 - util-weight) '
+                                '* tput instead of perfidx')
+  argparser.add_argument('--freeze', default = None,
+                         help = 'write the best parameters to this header, e.g. '
+                                'tuned_params.h, for make FROZEN=1')
   args = argparser.parse_args()
   MdriverTuner.main(args)
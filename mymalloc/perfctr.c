@@ -0,0 +1,146 @@
+/*
+ * perfctr.c - hardware performance counters via perf_event_open (Linux)
+ */
+#define _GNU_SOURCE
+#include <errno.h>
+#include <linux/perf_event.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "./perfctr.h"
+
+#define CACHE_MISS(cache) \
+  ((cache) | (PERF_COUNT_HW_CACHE_OP_READ << 8) | \
+   (PERF_COUNT_HW_CACHE_RESULT_MISS << 16))
+
+static const struct {
+  const char *name;
+  uint32_t type;
+  uint64_t config;
+} events[PERFCTR_NUM] = {
+  [PERFCTR_CYCLES] =
+    {"cycles", PERF_TYPE_HARDWARE, PERF_COUNT_HW_CPU_CYCLES},
+  [PERFCTR_INSTRUCTIONS] =
+    {"instrs", PERF_TYPE_HARDWARE, PERF_COUNT_HW_INSTRUCTIONS},
+  [PERFCTR_L1D_MISSES] =
+    {"L1D-miss", PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_L1D)},
+  [PERFCTR_LLC_MISSES] =
+    {"LLC-miss", PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_LL)},
+  [PERFCTR_DTLB_MISSES] =
+    {"dTLB-miss", PERF_TYPE_HW_CACHE, CACHE_MISS(PERF_COUNT_HW_CACHE_DTLB)},
+  [PERFCTR_BRANCH_MISSES] =
+    {"br-miss", PERF_TYPE_HARDWARE, PERF_COUNT_HW_BRANCH_MISSES},
+};
+
+static int fds[PERFCTR_NUM];
+static int leader = -1;   /* fd of the group leader, -1 if disabled */
+static int num_open = 0;  /* number of counters in the group */
+
+static int perf_event_open(struct perf_event_attr *attr, int group_fd) {
+  return (int) syscall(__NR_perf_event_open, attr, 0, -1, group_fd, 0);
+}
+
+/*
+ * perfctr_init - open every counter we can into one group
+ */
+int perfctr_init(void) {
+  struct perf_event_attr attr;
+  int i;
+
+  num_open = 0;
+  leader = -1;
+  for (i = 0; i < PERFCTR_NUM; i++) {
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = events[i].type;
+    attr.config = events[i].config;
+    attr.disabled = (leader == -1);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_ID |
+        PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+    fds[i] = perf_event_open(&attr, leader);
+    if (fds[i] < 0) {
+      continue;
+    }
+    if (leader == -1) {
+      leader = fds[i];
+    }
+    num_open++;
+  }
+  return num_open;
+}
+
+/*
+ * perfctr_deinit - close the counter group
+ */
+void perfctr_deinit(void) {
+  int i;
+  if (leader < 0) return;
+  for (i = 0; i < PERFCTR_NUM; i++) {
+    if (fds[i] >= 0) {
+      close(fds[i]);
+      fds[i] = -1;
+    }
+  }
+  leader = -1;
+  num_open = 0;
+}
+
+/*
+ * perfctr_start - reset and enable the whole group
+ */
+void perfctr_start(void) {
+  if (leader < 0) return;
+  ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+/*
+ * perfctr_stop - disable the group and read it. If the group was
+ *     multiplexed with other users of the PMU, scale the counts up to
+ *     the full enabled time.
+ */
+void perfctr_stop(perfctr_values_t *values) {
+  uint64_t buf[3 + 2 * PERFCTR_NUM];
+  uint64_t ids[PERFCTR_NUM];
+  int i, j;
+
+  memset(values, 0, sizeof(*values));
+  if (leader < 0) return;
+  ioctl(leader, PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+
+  for (i = 0; i < PERFCTR_NUM; i++) {
+    if (fds[i] < 0 || ioctl(fds[i], PERF_EVENT_IOC_ID, &ids[i]) != 0) {
+      ids[i] = (uint64_t) -1;
+    }
+  }
+
+  /* Layout: nr, time_enabled, time_running, {value, id} * nr */
+  if (read(leader, buf, sizeof(buf)) < (ssize_t) (3 * sizeof(uint64_t))) {
+    return;
+  }
+  uint64_t nr = buf[0];
+  double scale = 1.0;
+  if (buf[2] == 0) return;  /* never scheduled onto the PMU */
+  if (buf[2] < buf[1]) scale = (double) buf[1] / buf[2];
+
+  for (j = 0; j < (int) nr && j < PERFCTR_NUM; j++) {
+    uint64_t value = buf[3 + 2 * j];
+    uint64_t id = buf[4 + 2 * j];
+    for (i = 0; i < PERFCTR_NUM; i++) {
+      if (ids[i] == id) {
+        values->counts[i] = (uint64_t) (value * scale);
+        values->valid[i] = 1;
+      }
+    }
+  }
+}
+
+const char *perfctr_name(perfctr_event_t event) {
+  return events[event].name;
+}
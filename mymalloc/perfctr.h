@@ -0,0 +1,46 @@
+/*
+ * perfctr.h - hardware performance counters via perf_event_open
+ *
+ * The counters are opened as one group so that they are scheduled onto
+ * the PMU together and their ratios are meaningful. Counters the kernel
+ * or the hardware refuse (e.g. inside a restricted container) are simply
+ * left out; if none can be opened, perfctr_init returns 0 and the driver
+ * carries on without them.
+ */
+
+#ifndef MM_PERFCTR_H
+#define MM_PERFCTR_H
+
+#include <stdint.h>
+
+typedef enum {
+  PERFCTR_CYCLES,
+  PERFCTR_INSTRUCTIONS,
+  PERFCTR_L1D_MISSES,
+  PERFCTR_LLC_MISSES,
+  PERFCTR_DTLB_MISSES,
+  PERFCTR_BRANCH_MISSES,
+  PERFCTR_NUM
+} perfctr_event_t;
+
+typedef struct {
+  uint64_t counts[PERFCTR_NUM];
+  int valid[PERFCTR_NUM];  /* was this counter opened and read? */
+} perfctr_values_t;
+
+// Open the counter group. Returns the number of counters available.
+int perfctr_init(void);
+
+// Close the counter group.
+void perfctr_deinit(void);
+
+// Reset and enable the counters.
+void perfctr_start(void);
+
+// Disable the counters and read them into *values.
+void perfctr_stop(perfctr_values_t *values);
+
+// Short column name of a counter.
+const char *perfctr_name(perfctr_event_t event);
+
+#endif  // MM_PERFCTR_H
@@ -0,0 +1,14 @@
+// Generated by make_profiles.py from additional_traces. Do not edit.
+// name, size mix, realloc ratio, {min block, min split}  // perfidx
+static const workload_profile profiles[] = {
+  {"c0", {0.17, 0.24, 0.58, 0.01}, 0.00, {32, 256}},  // 96.72
+  {"c1", {0.01, 0.86, 0.10, 0.03}, 0.00, {32, 64}},  // 96.23
+  {"c2", {0.00, 0.01, 0.12, 0.87}, 0.00, {32, 512}},  // 95.89
+  {"c3", {0.66, 0.00, 0.33, 0.01}, 0.00, {32, 256}},  // 79.05
+  {"c4", {0.87, 0.00, 0.12, 0.01}, 0.00, {32, 64}},  // 91.84
+  {"c5", {0.02, 0.88, 0.09, 0.02}, 0.00, {32, 64}},  // 96.21
+  {"c6", {0.99, 0.00, 0.00, 0.01}, 0.00, {32, 64}},  // 86.86
+  {"c7", {0.00, 0.04, 0.38, 0.58}, 0.00, {32, 512}},  // 99.67
+  {"c8", {0.66, 0.33, 0.00, 0.01}, 0.00, {32, 128}},  // 82.76
+  {"c9", {0.50, 0.00, 0.00, 0.50}, 0.50, {32, 256}},  // 100.00
+};
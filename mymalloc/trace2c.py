@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+#
+# trace2c.py - compile a trace file into straight-line C that calls the
+# allocator directly.
+#
+# mdriver's eval_mm_speed interprets a trace: it switches on every op type,
+# calls through the malloc_impl_t function pointers and loads each block
+# from trace->blocks. That overhead is charged to the allocator. The code
+# generated here replays the same requests with direct calls to my_malloc,
+# my_realloc and my_free and constant sizes, so that mdriver-compiled -C
+# can show what the allocator itself costs per op.
+#
+# Usage: ./trace2c.py traces/trace_c0_v0 > compiled_trace.c
+#
+from __future__ import print_function
+import sys
+
+# Ops per generated function; keeps gcc -O3 compile times reasonable.
+CHUNK = 1000
+
+
+def read_trace(path):
+    with open(path) as f:
+        tokens = f.read().split()
+    num_ids = int(tokens[1])
+    num_ops = int(tokens[2])
+    ops = []
+    i = 4
+    while i < len(tokens):
+        kind = tokens[i]
+        if kind in ('a', 'c', 'r', 'w'):
+            ops.append((kind, int(tokens[i + 1]), int(tokens[i + 2])))
+            i += 3
+        elif kind == 'm':
+            ops.append((kind, int(tokens[i + 1]),
+                        (int(tokens[i + 2]), int(tokens[i + 3]))))
+            i += 4
+        elif kind == 'f':
+            ops.append((kind, int(tokens[i + 1]), 0))
+            i += 2
+        elif kind == 'A':
+            ops.append((kind, int(tokens[i + 1]),
+                        (int(tokens[i + 2]), int(tokens[i + 3]))))
+            i += 4
+        elif kind == 'F':
+            ops.append((kind, int(tokens[i + 1]), int(tokens[i + 2])))
+            i += 3
+        else:
+            sys.exit('Bogus type character (%s) in tracefile %s' % (kind, path))
+    assert len(ops) == num_ops
+    return num_ids, ops
+
+
+def emit_op(out, kind, index, size):
+    if kind == 'a':
+        out.append('  if ((b[%d] = my_malloc(%d)) == NULL) fail();' % (index, size))
+    elif kind == 'c':
+        out.append('  if ((b[%d] = my_calloc(1, %d)) == NULL) fail();' % (index, size))
+    elif kind == 'm':
+        out.append('  if ((b[%d] = my_aligned_alloc(%d, %d)) == NULL) fail();'
+                   % ((index,) + size))
+    elif kind == 'r':
+        out.append('  if ((b[%d] = my_realloc(b[%d], %d)) == NULL) fail();'
+                   % (index, index, size))
+    elif kind == 'f':
+        out.append('  my_free(b[%d]);' % index)
+    elif kind == 'A':
+        count, block_size = size
+        out.append('  if (my_malloc_batch(%d, %d, (void **) &b[%d]) != %d) fail();'
+                   % (block_size, count, index, count))
+    elif kind == 'F':
+        out.append('  my_free_batch((void **) &b[%d], %d);' % (index, size))
+    elif size > 1:
+        out.append('  write_block(b[%d], %d);' % (index, size))
+
+
+def main():
+    if len(sys.argv) != 2:
+        sys.exit('usage: %s <tracefile>' % sys.argv[0])
+    path = sys.argv[1]
+    num_ids, ops = read_trace(path)
+    chunks = (len(ops) + CHUNK - 1) // CHUNK
+
+    out = []
+    out.append('/* Generated by trace2c.py from %s. Do not edit. */' % path)
+    out.append('#include <stdio.h>')
+    out.append('#include <stdlib.h>')
+    out.append('#include "./allocator_interface.h"')
+    out.append('#include "./memlib.h"')
+    out.append('')
+    out.append('const char *compiled_trace_file = "%s";' % path)
+    out.append('const int compiled_trace_ops = %d;' % len(ops))
+    out.append('')
+    out.append('static char *b[%d];' % max(num_ids, 1))
+    out.append('')
+    out.append('static void fail(void) {')
+    out.append('  printf("allocation failed in compiled trace\\n");')
+    out.append('  exit(1);')
+    out.append('}')
+    # Only traces with writes need the helper; gcc warns about an unused one
+    if any(kind == 'w' and size > 1 for kind, index, size in ops):
+        out.append('')
+        out.append('/* Same work per byte as mem_op in mdriver.c */')
+        out.append('static void write_block(char *p, int size) {')
+        out.append('  volatile char *q = p;')
+        out.append('  for (int offset = 1; offset < size; offset++) {')
+        out.append('    q[offset] = q[offset - 1] ^ 0x7B;')
+        out.append('  }')
+        out.append('}')
+    for c in range(chunks):
+        out.append('')
+        out.append('static __attribute__((noinline)) void chunk_%d(void) {' % c)
+        for kind, index, size in ops[c * CHUNK:(c + 1) * CHUNK]:
+            emit_op(out, kind, index, size)
+        out.append('}')
+    out.append('')
+    out.append('/* Reset the heap, initialize the allocator and replay the trace */')
+    out.append('void compiled_trace_run(void *unused) {')
+    out.append('  mem_reset_brk();')
+    out.append('  if (my_init() < 0) fail();')
+    for c in range(chunks):
+        out.append('  chunk_%d();' % c)
+    out.append('}')
+    print('\n'.join(out))
+
+
+if __name__ == '__main__':
+    main()
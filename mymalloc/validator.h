@@ -157,6 +157,7 @@ int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
   int index = 0;
   int size = 0;
   int oldsize = 0;
+  int count = 0;
   char *newp = NULL;
   char *oldp = NULL;
   char *p = NULL;
@@ -200,6 +201,44 @@ int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
         trace->block_sizes[index] = size;
         break;
 
+      case ALLOC_ALIGNED:  // aligned_alloc
+
+        // Checked like a malloc'd block, and for the requested alignment
+        if ((p = (char *) impl->aligned_alloc(trace->ops[i].align, size)) == NULL) {
+          malloc_error(tracenum, i, "impl aligned_alloc failed.");
+          return 0;
+        }
+        if ((uintptr_t) p % trace->ops[i].align != 0) {
+          malloc_error(tracenum, i, "Payload address is not aligned as requested.");
+          return 0;
+        }
+        if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
+          return 0;
+        memset(p, FILLER(p, size, index), size);
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        break;
+
+      case CALLOC:  // calloc
+
+        // Checked like a malloc'd block, and for being zeroed
+        if ((p = (char *) impl->calloc(1, size)) == NULL) {
+          malloc_error(tracenum, i, "impl calloc failed.");
+          return 0;
+        }
+        if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
+          return 0;
+        for (int j = 0; j < size; j++) {
+          if (p[j] != 0) {
+            malloc_error(tracenum, i, "calloc'd block is not zeroed.");
+            return 0;
+          }
+        }
+        memset(p, FILLER(p, size, index), size);
+        trace->blocks[index] = p;
+        trace->block_sizes[index] = size;
+        break;
+
       case REALLOC:  // realloc
 
         // Call the student's realloc
@@ -243,6 +282,41 @@ int eval_mm_valid(const malloc_impl_t *impl, trace_t *trace, int tracenum) {
         impl->free(p);
         break;
 
+      case FREE_SIZED:  // free_sized
+
+        // Like free, with the size the block was last given
+        p = trace->blocks[index];
+        remove_range(&ranges, p);
+        impl->free_sized(p, trace->block_sizes[index]);
+        break;
+
+      case ALLOC_BATCH:  // malloc_batch
+
+        // Every block of the batch is checked like a malloc'd one
+        count = trace->ops[i].count;
+        if (impl->malloc_batch(size, count, (void **) &trace->blocks[index]) !=
+            (size_t) count) {
+          malloc_error(tracenum, i, "impl malloc_batch failed.");
+          return 0;
+        }
+        for (int j = 0; j < count; j++) {
+          p = trace->blocks[index + j];
+          if (add_range(impl, &ranges, p, size, tracenum, i) == 0)
+            return 0;
+          memset(p, FILLER(p, size, index + j), size);
+          trace->block_sizes[index + j] = size;
+        }
+        break;
+
+      case FREE_BATCH:  // free_batch
+
+        count = trace->ops[i].count;
+        for (int j = 0; j < count; j++) {
+          remove_range(&ranges, trace->blocks[index + j]);
+        }
+        impl->free_batch((void **) &trace->blocks[index], count);
+        break;
+
       case WRITE:  // write
 
         break;